@@ -187,7 +187,59 @@ struct id_interface
     // one.
     virtual bool
     less_than(id_interface const& other) const = 0;
+
+    // Compute a hash of the ID. (Equal IDs must have equal hashes.)
+    // ID types that can't be hashed return no_id_hash. (See make_id_hash().)
+    virtual std::size_t
+    hash() const = 0;
+};
+
+// This is the hash of IDs that can't be hashed. Maps fall back to ordered
+// lookups for them.
+static constexpr std::size_t no_id_hash = 0;
+
+// Convert a hash value to an ID hash (by avoiding no_id_hash).
+inline std::size_t
+make_id_hash(std::size_t hash)
+{
+    return hash != no_id_hash ? hash : 1;
+}
+
+// Combine two ID hashes. (The result can't be hashed if either input can't.)
+inline std::size_t
+combine_id_hashes(std::size_t a, std::size_t b)
+{
+    if (a == no_id_hash || b == no_id_hash)
+        return no_id_hash;
+    return make_id_hash(a ^ (b + 0x9e3779b9 + (a << 6) + (a >> 2)));
+}
+
+// Is there a std::hash for T?
+template<class T, class = void_t<>>
+struct is_std_hashable : std::false_type
+{
 };
+template<class T>
+struct is_std_hashable<
+    T,
+    void_t<decltype(std::hash<T>()(std::declval<T const&>()))>>
+    : std::true_type
+{
+};
+
+// Get the ID hash for a value (or no_id_hash if it can't be hashed).
+template<class Value>
+std::enable_if_t<is_std_hashable<Value>::value, std::size_t>
+hash_id_value(Value const& value)
+{
+    return make_id_hash(std::hash<Value>()(value));
+}
+template<class Value>
+std::enable_if_t<!is_std_hashable<Value>::value, std::size_t>
+hash_id_value(Value const&)
+{
+    return no_id_hash;
+}
 
 // The following convert the interface of the ID operations into the usual form
 // that one would expect, as free functions.
@@ -343,6 +395,12 @@ struct id_ref : id_interface
         return *id_ < *other_id.id_;
     }
 
+    std::size_t
+    hash() const
+    {
+        return id_->hash();
+    }
+
     void
     deep_copy(id_interface* copy) const
     {
@@ -409,6 +467,12 @@ struct simple_id : id_interface
         return value_ < other_id.value_;
     }
 
+    std::size_t
+    hash() const
+    {
+        return hash_id_value(value_);
+    }
+
     void
     deep_copy(id_interface* copy) const
     {
@@ -463,6 +527,12 @@ struct simple_id_by_reference : id_interface
         return *value_ < *other_id.value_;
     }
 
+    std::size_t
+    hash() const
+    {
+        return hash_id_value(*value_);
+    }
+
     void
     deep_copy(id_interface* copy) const
     {
@@ -527,6 +597,12 @@ struct id_pair : id_interface
                || (id0_.equals(other_id.id0_) && id1_.less_than(other_id.id1_));
     }
 
+    std::size_t
+    hash() const
+    {
+        return combine_id_hashes(id0_.hash(), id1_.hash());
+    }
+
     void
     deep_copy(id_interface* copy) const
     {
@@ -3769,7 +3845,8 @@ struct scoped_component_container
 
 } // namespace alia
 
-
+#include <cstddef>
+#include <new>
 
 // This file defines the data retrieval library used for associating mutable
 // state and cached data with alia content graphs. It is designed so that each
@@ -3829,6 +3906,60 @@ namespace alia {
 // Other nodes are irrelevant, and the library never knows about them.
 // Furthermore, not all edges need to be stored explicitly.
 
+// data_node_allocator allocates the data nodes for a data_graph. (The graph's
+// named blocks and the references to them are allocated from it as well.)
+//
+// A large UI can have tens of thousands of data nodes, and they tend to be
+// created and destroyed in bulk (e.g., when a long list first appears or is
+// taken away), so rather than going to the general-purpose heap for each one,
+// nodes are carved out of larger slabs. Node sizes are rounded up to a multiple
+// of slot_granularity, and a freed node goes onto the free list for its size
+// class, to be reused by the next node of that size. The slabs themselves are
+// only released (all at once) when the allocator is destroyed, so every node
+// must be destroyed before the allocator that it came from.
+//
+// Slabs are aligned to their size so that a node's allocator can be found from
+// the node's address alone. Nodes that are too large for any size class go
+// directly to the heap.
+struct data_node_allocator : noncopyable
+{
+    static constexpr std::size_t slab_size = 16384;
+    static constexpr std::size_t slot_granularity = 16;
+    static constexpr std::size_t size_class_count = 16;
+
+    ~data_node_allocator();
+
+    void*
+    allocate(std::size_t size);
+
+    // Return a node's memory to the allocator that it came from.
+    static void
+    deallocate(void* p, std::size_t size);
+
+    // the number of slabs that have been allocated
+    std::size_t slab_count = 0;
+
+    // the number of nodes that are currently allocated from the slabs
+    std::size_t live_node_count = 0;
+
+ private:
+    struct slab_header;
+
+    struct free_slot
+    {
+        free_slot* next;
+    };
+
+    void
+    add_slab();
+
+    free_slot* free_lists_[size_class_count] = {};
+    slab_header* slabs_ = nullptr;
+    // the unused portion of the newest slab
+    char* slab_cursor_ = nullptr;
+    char* slab_end_ = nullptr;
+};
+
 // data_node represents a node in the data graph that stores data.
 struct data_node : noncopyable
 {
@@ -3842,6 +3973,17 @@ struct data_node : noncopyable
     }
 
     data_node* next = nullptr;
+
+    // Data nodes are allocated by their graph (see get_data_node()), so they
+    // can't be created with a plain new expression. Deleting one returns it to
+    // its graph's allocator.
+    static void*
+    operator new(std::size_t) = delete;
+    static void
+    operator delete(void* p, std::size_t size)
+    {
+        data_node_allocator::deallocate(p, size);
+    }
 };
 
 struct named_block_ref_node;
@@ -3884,6 +4026,9 @@ struct naming_map_node;
 // data_graph stores the data graph associated with a function.
 struct data_graph : noncopyable
 {
+    // (This has to be declared first so that it outlives all the nodes.)
+    data_node_allocator node_allocator;
+
     data_block root_block;
 
     naming_map_node* map_list = nullptr;
@@ -3908,6 +4053,10 @@ struct data_traversal
     naming_map* active_map;
     data_block* active_block;
     named_block_ref_node* predicted_named_block;
+    // references from the predicted list that were passed over (because a
+    // block further down the list was requested first) but that might still be
+    // requested later in the pass
+    named_block_ref_node* skipped_named_blocks;
     named_block_ref_node* used_named_blocks;
     named_block_ref_node** named_block_next_ptr;
     data_node** next_data_ptr;
@@ -3972,6 +4121,7 @@ struct scoped_data_block : noncopyable
     // old state
     data_block* old_active_block_;
     named_block_ref_node* old_predicted_named_block_;
+    named_block_ref_node* old_skipped_named_blocks_;
     named_block_ref_node* old_used_named_blocks_;
     named_block_ref_node** old_named_block_next_ptr_;
     data_node** old_next_data_ptr_;
@@ -4211,7 +4361,21 @@ get_data_node(Context& ctx, Node** ptr)
     }
     else
     {
-        Node* new_node = new Node;
+        static_assert(
+            alignof(Node) <= data_node_allocator::slot_granularity,
+            "data nodes can't be overaligned");
+        void* memory
+            = traversal.graph->node_allocator.allocate(sizeof(Node));
+        Node* new_node;
+        try
+        {
+            new_node = ::new (memory) Node;
+        }
+        catch (...)
+        {
+            data_node_allocator::deallocate(memory, sizeof(Node));
+            throw;
+        }
         *traversal.next_data_ptr = new_node;
         traversal.next_data_ptr = &new_node->next;
         *ptr = new_node;
@@ -4251,17 +4415,70 @@ get_data(Context& ctx)
 // generated by the application. The system assumes that the data can be
 // regenerated if it's lost.
 
+// When a cached value is cleared, it's normally destroyed. A type can instead
+// provide an overload of clear_cached_value() that releases the value's data
+// in place and returns true, in which case the value stays constructed (and
+// isn't considered new the next time it's retrieved). This is useful when
+// part of the value (e.g., a captured key) is worth keeping around.
+template<class T>
+bool
+clear_cached_value(T&)
+{
+    return false;
+}
+
+// The value is stored inline (rather than separately allocated) and is only
+// constructed while the cache is populated, so clearing the cache and later
+// regenerating the value doesn't involve the heap (unless the value itself
+// does).
 template<class T>
 struct cached_data_node : data_node
 {
-    // TODO: Use optional instead.
-    std::unique_ptr<T> value;
+    ~cached_data_node()
+    {
+        destroy();
+    }
+
+    bool
+    is_constructed() const
+    {
+        return constructed_;
+    }
+
+    T*
+    get()
+    {
+        return reinterpret_cast<T*>(storage_);
+    }
+
+    void
+    construct()
+    {
+        assert(!constructed_);
+        ::new (storage_) T;
+        constructed_ = true;
+    }
+
+    void
+    destroy()
+    {
+        if (constructed_)
+        {
+            get()->~T();
+            constructed_ = false;
+        }
+    }
 
     void
     clear_cache()
     {
-        value.reset();
+        if (constructed_ && !clear_cached_value(*get()))
+            destroy();
     }
+
+ private:
+    alignas(T) unsigned char storage_[sizeof(T)];
+    bool constructed_ = false;
 };
 
 template<class Context, class T>
@@ -4270,10 +4487,10 @@ get_cached_data(Context& ctx, T** ptr)
 {
     cached_data_node<T>* node;
     get_data_node(ctx, &node);
-    bool is_new = !node->value;
+    bool is_new = !node->is_constructed();
     if (is_new)
-        node->value.reset(new T);
-    *ptr = node->value.get();
+        node->construct();
+    *ptr = node->get();
     return is_new;
 }
 
@@ -4329,6 +4546,18 @@ mark_valid(keyed_data<Data>& data)
     data.is_valid = true;
 }
 
+// Clearing keyed data from the cache releases the data itself but keeps the
+// key's storage, so that recapturing the key doesn't have to allocate.
+// (Since the data is marked invalid, it's still regenerated.)
+template<class Data>
+bool
+clear_cached_value(keyed_data<Data>& data)
+{
+    data.value = Data();
+    data.is_valid = false;
+    return true;
+}
+
 template<class Data>
 bool
 refresh_keyed_data(keyed_data<Data>& data, id_interface const& key)
@@ -4432,24 +4661,34 @@ struct raw_keyed_data
 {
     captured_id key;
     Data data;
+    // Has :data been handed out for :key? (This is cleared along with the
+    // cache, while :key keeps its storage. See clear_cached_value().)
+    bool is_valid = false;
 };
 
+template<class Data>
+bool
+clear_cached_value(raw_keyed_data<Data>& data)
+{
+    data.data = Data();
+    data.is_valid = false;
+    return true;
+}
+
 template<class Context, class Data>
 bool
 get_keyed_data(Context ctx, id_interface const& key, Data** data)
 {
     raw_keyed_data<Data>* ptr;
-    bool is_new = false;
-    if (get_cached_data(ctx, &ptr))
-    {
-        ptr->key.capture(key);
-        is_new = true;
-    }
-    else if (!ptr->key.matches(key))
+    get_cached_data(ctx, &ptr);
+    bool is_new = !ptr->is_valid || !ptr->key.matches(key);
+    if (is_new)
     {
+        // If the data was cleared (or just constructed), it's already fresh.
+        if (ptr->is_valid)
+            ptr->data = Data();
         ptr->key.capture(key);
-        ptr->data = Data();
-        is_new = true;
+        ptr->is_valid = true;
     }
     *data = &ptr->data;
     return is_new;
@@ -4917,6 +5156,13 @@ system_needs_refresh(system const& sys);
 void
 refresh_system(system& sys);
 
+// Request a refresh of the system in response to something that happened
+// outside of a refresh (an event, the completion of an async operation, etc.).
+// This is delegated to the system's external interface, which normally just
+// refreshes the system immediately.
+void
+request_refresh(system& sys);
+
 } // namespace alia
 
 
@@ -5007,7 +5253,7 @@ void
 dispatch_event(system& sys, Event& event)
 {
     impl::dispatch_event(sys, event);
-    refresh_system(sys);
+    request_refresh(sys);
 }
 
 struct traversal_abortion
@@ -5097,7 +5343,7 @@ dispatch_targeted_event(
 {
     event.target_id = component.id;
     impl::dispatch_targeted_event(sys, event, component.identity);
-    refresh_system(sys);
+    request_refresh(sys);
 }
 
 template<class Event>
@@ -6632,6 +6878,10 @@ for_each(Context ctx, Container&& container, Fn&& fn)
 } // namespace alia
 
 
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
 
 namespace alia {
 
@@ -6686,21 +6936,113 @@ struct tree_node : noncopyable
     tree_node* children_ = nullptr;
 };
 
+template<class Object>
+struct tree_reconciliation;
+
 template<class Object>
 struct tree_traversal
 {
     tree_node<Object>* last_sibling = nullptr;
     tree_node<Object>** next_ptr = nullptr;
     tree_node<Object>* active_parent = nullptr;
+    // If this is set, movement among the children of its parent is deferred.
+    // (See scoped_tree_reconciliation below.)
+    tree_reconciliation<Object>* reconciliation = nullptr;
+};
+
+// tree_reconciliation is the state of a section of siblings whose movements
+// are being deferred.
+//
+// Normally, when a node isn't where it's expected, it's relocated on the spot.
+// This is fine for most content, but for keyed lists that are reordered, it
+// tends to move far more nodes than necessary. (e.g., Rotating A B C D to
+// B C D A moves B, C and D.)
+//
+// In deferred mode, the sibling list is still updated as the traversal goes
+// along, but once the first out-of-place node is encountered, the objects
+// themselves aren't relocated. Instead, the old order of the remaining
+// siblings is captured, and the new order is recorded as it's traversed. At
+// the end of the section, a longest increasing subsequence of the nodes' old
+// positions is computed. Those nodes stay where they are, and only the others
+// are relocated (so that rotation only moves A).
+//
+// Until something is actually out of place, this costs nothing.
+template<class Object>
+struct tree_reconciliation
+{
+    // the parent node whose children are being reconciled
+    tree_node<Object>* parent = nullptr;
+
+    // Have we started deferring movement?
+    bool deferring = false;
+
+    // the sibling that preceded the section at the point when deferring began
+    tree_node<Object>* last_sibling_before = nullptr;
+
+    // the old positions of the siblings that remained at that point
+    std::unordered_map<tree_node<Object>*, int> old_positions;
+
+    // the nodes that have been visited since, in order, along with their old
+    // positions (or -1 for nodes that weren't there before)
+    std::vector<std::pair<tree_node<Object>*, int>> new_order;
 };
 
+template<class Object>
+tree_reconciliation<Object>*
+get_active_reconciliation(tree_traversal<Object>& traversal)
+{
+    tree_reconciliation<Object>* reconciliation = traversal.reconciliation;
+    return reconciliation
+                   && reconciliation->parent == traversal.active_parent
+               ? reconciliation
+               : nullptr;
+}
+
+template<class Object>
+void
+record_reconciled_node(
+    tree_reconciliation<Object>& reconciliation, tree_node<Object>& node)
+{
+    int old_position = -1;
+    // Only nodes that are currently in a list can have an old position.
+    if (node.prev_)
+    {
+        auto i = reconciliation.old_positions.find(&node);
+        if (i != reconciliation.old_positions.end())
+            old_position = i->second;
+    }
+    reconciliation.new_order.emplace_back(&node, old_position);
+}
+
 template<class Object>
 void
 check_for_movement(tree_traversal<Object>& traversal, tree_node<Object>& node)
 {
     tree_node<Object>* expected_node = *traversal.next_ptr;
-    if (expected_node != &node)
+    tree_reconciliation<Object>* reconciliation
+        = get_active_reconciliation(traversal);
+    if (reconciliation && reconciliation->deferring)
     {
+        record_reconciled_node(*reconciliation, node);
+        if (expected_node != &node)
+        {
+            node.remove_from_list();
+            node.insert_into_list(traversal.next_ptr, expected_node);
+        }
+    }
+    else if (expected_node != &node)
+    {
+        // Appending to the end is never worth deferring.
+        if (reconciliation && expected_node)
+        {
+            reconciliation->deferring = true;
+            reconciliation->last_sibling_before = traversal.last_sibling;
+            int position = 0;
+            for (tree_node<Object>* i = expected_node; i; i = i->next_)
+                reconciliation->old_positions[i] = position++;
+            check_for_movement(traversal, node);
+            return;
+        }
         node.remove_from_list();
         node.object.relocate(
             traversal.active_parent->object,
@@ -6746,6 +7088,13 @@ cap_sibling_list(tree_traversal<Object>& traversal)
         do
         {
             expected_node->object.remove();
+            // The node's children are gone too (as far as their objects are
+            // concerned), even though they're only destroyed later.
+            for (tree_node<Object>* child = expected_node->children_; child;
+                 child = child->next_)
+            {
+                child->object.orphan();
+            }
             expected_node->remove_from_list();
             expected_node->prev_ = nullptr;
             expected_node = expected_node->next_;
@@ -6837,6 +7186,178 @@ struct scoped_tree_children
     tree_traversal<Object> old_traversal_state_;
 };
 
+// Splice a run of existing sibling nodes (from :head through :last) into the
+// current position of the traversal, as if they had been traversed.
+template<class Object>
+void
+splice_tree_nodes(
+    tree_traversal<Object>& traversal,
+    tree_node<Object>& head,
+    tree_node<Object>& last)
+{
+    tree_reconciliation<Object>* reconciliation
+        = get_active_reconciliation(traversal);
+    if (*traversal.next_ptr == &head
+        && !(reconciliation && reconciliation->deferring))
+    {
+        // This is the common case: The nodes are already in place, so just
+        // skip over them.
+        traversal.next_ptr = &last.next_;
+        traversal.last_sibling = &last;
+        return;
+    }
+    // Otherwise, handle them individually.
+    tree_node<Object>* node = &head;
+    while (true)
+    {
+        // Note that this has to be read before the node is (potentially)
+        // moved.
+        tree_node<Object>* next = node->next_;
+        refresh_tree_node(traversal, *node);
+        if (node == &last)
+            break;
+        node = next;
+    }
+}
+
+// Compute a longest strictly increasing subsequence of :values, ignoring any
+// values that are negative or not less than :limit. The result is returned by
+// setting the corresponding entries in :included to true.
+inline void
+find_longest_increasing_subsequence(
+    std::vector<int> const& values, int limit, std::vector<bool>& included)
+{
+    std::size_t n = values.size();
+    included.assign(n, false);
+    // tails[k] is the index of the smallest value that ends an increasing
+    // subsequence of length k + 1.
+    std::vector<int> tails;
+    std::vector<int> predecessors(n, -1);
+    for (std::size_t i = 0; i != n; ++i)
+    {
+        int value = values[i];
+        if (value < 0 || value >= limit)
+            continue;
+        std::size_t low = 0, high = tails.size();
+        while (low < high)
+        {
+            std::size_t mid = (low + high) / 2;
+            if (values[tails[mid]] < value)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        if (low != 0)
+            predecessors[i] = tails[low - 1];
+        if (low == tails.size())
+            tails.push_back(int(i));
+        else
+            tails[low] = int(i);
+    }
+    for (int i = tails.empty() ? -1 : tails.back(); i >= 0;
+         i = predecessors[i])
+    {
+        included[i] = true;
+    }
+}
+
+// Apply the deferred movements for a section of siblings.
+template<class Object>
+void
+apply_reconciliation(
+    tree_traversal<Object>& traversal,
+    tree_reconciliation<Object>& reconciliation)
+{
+    if (!reconciliation.deferring)
+        return;
+
+    auto const& new_order = reconciliation.new_order;
+
+    // Anything that follows the section is still in its old position, so
+    // nodes within the section can only stay where they are if they came
+    // before it.
+    tree_node<Object>* following = *traversal.next_ptr;
+    int limit = std::numeric_limits<int>::max();
+    if (following)
+    {
+        auto i = reconciliation.old_positions.find(following);
+        if (i != reconciliation.old_positions.end())
+            limit = i->second;
+    }
+
+    std::vector<int> old_positions;
+    old_positions.reserve(new_order.size());
+    for (auto const& entry : new_order)
+        old_positions.push_back(entry.second);
+    std::vector<bool> stationary;
+    find_longest_increasing_subsequence(old_positions, limit, stationary);
+
+    // Work backwards so that each node can be placed before its successor,
+    // which is already in its final place.
+    tree_node<Object>* before = following;
+    for (std::size_t i = new_order.size(); i-- != 0;)
+    {
+        tree_node<Object>* node = new_order[i].first;
+        if (!stationary[i])
+        {
+            tree_node<Object>* after
+                = i != 0 ? new_order[i - 1].first
+                         : reconciliation.last_sibling_before;
+            node->object.relocate(
+                reconciliation.parent->object,
+                after ? &after->object : nullptr,
+                before ? &before->object : nullptr);
+        }
+        before = node;
+    }
+}
+
+// scoped_tree_reconciliation defers the movement of the nodes that are added
+// to the active parent within its scope. (See tree_reconciliation above.)
+// This is intended for keyed content (e.g., for_each over a container whose
+// items can be reordered).
+template<class Object>
+struct scoped_tree_reconciliation : noncopyable
+{
+    scoped_tree_reconciliation() : traversal_(nullptr)
+    {
+    }
+    scoped_tree_reconciliation(tree_traversal<Object>& traversal)
+    {
+        begin(traversal);
+    }
+    ~scoped_tree_reconciliation()
+    {
+        if (!std::uncaught_exception())
+            end();
+    }
+
+    void
+    begin(tree_traversal<Object>& traversal)
+    {
+        traversal_ = &traversal;
+        reconciliation_.parent = traversal.active_parent;
+        old_reconciliation_ = traversal.reconciliation;
+        traversal.reconciliation = &reconciliation_;
+    }
+
+    void
+    end()
+    {
+        if (traversal_)
+        {
+            apply_reconciliation(*traversal_, reconciliation_);
+            traversal_->reconciliation = old_reconciliation_;
+            traversal_ = nullptr;
+        }
+    }
+
+ private:
+    tree_traversal<Object>* traversal_;
+    tree_reconciliation<Object> reconciliation_;
+    tree_reconciliation<Object>* old_reconciliation_;
+};
+
 template<class Object, class Content>
 void
 traverse_object_tree(
@@ -6894,11 +7415,10 @@ struct scoped_tree_cacher
         if (!data.content_id.matches(content_id))
             content_traversal_required_ = true;
 
-        // Check to see that we're inserting this where it's expected.
-        // If not, traverse the contents. (It's not technically necessary to do
-        // this. We could instead move the cached contents here, but this is
-        // easier and fine for now.)
-        if (data.predecessor != traversal.next_ptr)
+        // If the cached nodes have been removed from the tree since they were
+        // created, they'll have to be created again.
+        bool empty = data.subtree_tail == data.predecessor;
+        if (!empty && !data.subtree_head->prev_)
             content_traversal_required_ = true;
 
         if (content_traversal_required_)
@@ -6910,12 +7430,12 @@ struct scoped_tree_cacher
             // Also record the current value of the tree traversal's next_ptr.
             predecessor_ = traversal.next_ptr;
         }
-        else
+        else if (!empty)
         {
             // And if we're not updating the contents, just splice it in.
-            *traversal.next_ptr = data.subtree_head;
-            traversal.next_ptr = data.subtree_tail;
-            traversal.last_sibling = data.last_sibling;
+            // (If it's not where it's expected, this moves it here.)
+            splice_tree_nodes(
+                traversal, *data.subtree_head, *data.last_sibling);
         }
     }
 
@@ -7080,7 +7600,7 @@ async(Context ctx, Launcher launcher, Args const&... args)
                           data.result = std::move(result);
                           data.status = async_status::COMPLETE;
                           mark_dirty_component(container);
-                          refresh_system(*system);
+                          request_refresh(*system);
                       }
                   };
             try
@@ -8522,6 +9042,16 @@ struct external_interface
     schedule_timer_event(
         external_component_id component, millisecond_count time)
         = 0;
+
+    // alia calls this when something outside of a refresh (e.g., an event)
+    // requires the system to be refreshed.
+    //
+    // The default implementation refreshes the system immediately, but this
+    // can be overridden to defer (and coalesce) refreshes.
+    //
+    virtual void
+    request_refresh()
+        = 0;
 };
 
 struct default_external_interface : external_interface
@@ -8543,6 +9073,9 @@ struct default_external_interface : external_interface
     void
     schedule_timer_event(
         external_component_id component, millisecond_count time);
+
+    void
+    request_refresh();
 };
 
 struct system : noncopyable
@@ -9300,6 +9833,14 @@ namespace alia {
 
 struct named_block_node;
 
+// naming_map maps IDs to the named blocks within a naming context.
+//
+// Blocks are indexed by the hashes of their IDs in an open-addressing hash
+// table (with linear probing), so lookups that miss the prediction (e.g., in
+// a list that was just filtered or re-keyed) cost a hash and usually a single
+// ID comparison. Blocks whose IDs can't be hashed are kept in an ordered map
+// instead. Defining ALIA_ORDERED_NAMING_MAPS puts all blocks in the ordered
+// map.
 struct naming_map
 {
     typedef std::map<
@@ -9307,7 +9848,48 @@ struct naming_map
         named_block_node*,
         id_interface_pointer_less_than_test>
         map_type;
-    map_type blocks;
+
+    // Find the block with the given ID (and ID hash), or return nullptr if
+    // there isn't one.
+    named_block_node*
+    find(id_interface const& id, std::size_t hash) const;
+
+    // Insert a block. (There must not already be one with the same ID.)
+    void
+    insert(named_block_node* node);
+
+    // Remove a block.
+    void
+    erase(named_block_node* node);
+
+    // Invoke :fn on every block in the map.
+    template<class Fn>
+    void
+    for_each_block(Fn&& fn) const
+    {
+        for (auto const& slot : slots)
+        {
+            if (slot.node)
+                fn(slot.node);
+        }
+        for (auto const& entry : ordered_blocks)
+            fn(entry.second);
+    }
+
+    struct slot
+    {
+        std::size_t hash = 0;
+        named_block_node* node = nullptr;
+    };
+
+    // the hash table - Its size is always zero or a power of two.
+    std::vector<slot> slots;
+
+    // the number of blocks in the hash table
+    std::size_t hashed_count = 0;
+
+    // blocks whose IDs can't be hashed
+    map_type ordered_blocks;
 };
 
 struct named_block_node : noncopyable
@@ -9320,8 +9902,9 @@ struct named_block_node : noncopyable
     // the actual data block
     data_block block;
 
-    // the ID of the block
+    // the ID of the block (and its hash)
     captured_id id;
+    std::size_t id_hash = no_id_hash;
 
     // count of references to this block by data_blocks
     int reference_count;
@@ -9338,6 +9921,19 @@ struct named_block_node : noncopyable
     // to know where that map is so it can remove itself if it's no longer
     // needed.
     naming_map* map;
+
+    // Like data nodes, named blocks are allocated from their graph's node
+    // allocator.
+    static void*
+    operator new(std::size_t size, data_node_allocator& allocator)
+    {
+        return allocator.allocate(size);
+    }
+    static void
+    operator delete(void* p, std::size_t size)
+    {
+        data_node_allocator::deallocate(p, size);
+    }
 };
 
 // naming_maps are always created via a naming_map_node, which takes care of
@@ -9358,20 +9954,139 @@ struct naming_map_node : noncopyable
     naming_map_node* next;
     naming_map_node* prev;
 };
+static bool
+is_hash_indexed(std::size_t hash)
+{
+#ifdef ALIA_ORDERED_NAMING_MAPS
+    return false;
+#else
+    return hash != no_id_hash;
+#endif
+}
+
+// Get the preferred slot for a hash in a table of the given size.
+// (The hash is scrambled first, since hashes of integers are often just the
+// integers themselves.)
+static std::size_t
+get_home_slot(std::size_t hash, std::size_t table_size)
+{
+    return std::size_t(std::uint64_t(hash) * 0x9e3779b97f4a7c15ull >> 32)
+           & (table_size - 1);
+}
+
+named_block_node*
+naming_map::find(id_interface const& id, std::size_t hash) const
+{
+    if (!is_hash_indexed(hash))
+    {
+        auto i = ordered_blocks.find(&id);
+        return i != ordered_blocks.end() ? i->second : nullptr;
+    }
+    if (slots.empty())
+        return nullptr;
+    std::size_t mask = slots.size() - 1;
+    std::size_t i = get_home_slot(hash, slots.size());
+    while (slots[i].node)
+    {
+        slot const& s = slots[i];
+        if (s.hash == hash && s.node->id.get() == id)
+            return s.node;
+        i = (i + 1) & mask;
+    }
+    return nullptr;
+}
+
+static void
+insert_into_slots(
+    std::vector<naming_map::slot>& slots,
+    std::size_t hash,
+    named_block_node* node)
+{
+    std::size_t mask = slots.size() - 1;
+    std::size_t i = get_home_slot(hash, slots.size());
+    while (slots[i].node)
+        i = (i + 1) & mask;
+    slots[i].hash = hash;
+    slots[i].node = node;
+}
+
+void
+naming_map::insert(named_block_node* node)
+{
+    std::size_t hash = node->id_hash;
+    if (!is_hash_indexed(hash))
+    {
+        ordered_blocks[&node->id.get()] = node;
+        return;
+    }
+    // Keep the load factor at or below 1/2.
+    if ((hashed_count + 1) * 2 > slots.size())
+    {
+        std::vector<slot> old_slots(slots.empty() ? 16 : slots.size() * 2);
+        std::swap(old_slots, slots);
+        for (auto const& s : old_slots)
+        {
+            if (s.node)
+                insert_into_slots(slots, s.hash, s.node);
+        }
+    }
+    insert_into_slots(slots, hash, node);
+    ++hashed_count;
+}
+
+void
+naming_map::erase(named_block_node* node)
+{
+    std::size_t hash = node->id_hash;
+    if (!is_hash_indexed(hash))
+    {
+        ordered_blocks.erase(&node->id.get());
+        return;
+    }
+    std::size_t mask = slots.size() - 1;
+    std::size_t i = get_home_slot(hash, slots.size());
+    while (slots[i].node != node)
+    {
+        assert(slots[i].node);
+        i = (i + 1) & mask;
+    }
+    // Shift later entries in the same run back to fill the gap (so that no
+    // tombstones are needed).
+    std::size_t j = i;
+    while (true)
+    {
+        j = (j + 1) & mask;
+        if (!slots[j].node)
+            break;
+        std::size_t home = get_home_slot(slots[j].hash, slots.size());
+        // If the entry's home is cyclically within (i, j], it has to stay.
+        bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays)
+        {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+    slots[i] = slot();
+    --hashed_count;
+}
+
 naming_map_node::~naming_map_node()
 {
     // Remove the association between any named_blocks left in the map and
     // the map itself.
-    for (naming_map::map_type::const_iterator i = map.blocks.begin();
-         i != map.blocks.end();
-         ++i)
-    {
-        named_block_node* node = i->second;
+    // Deleting a block can release references to others in the same map
+    // (which would then remove themselves from it), so first detach all of
+    // them from the map, and only then delete the ones that are unreferenced.
+    // (The others are deleted when their last reference goes away.)
+    std::vector<named_block_node*> unreferenced;
+    map.for_each_block([&](named_block_node* node) {
+        node->map = 0;
         if (node->reference_count == 0)
-            delete node;
-        else
-            node->map = 0;
-    }
+            unreferenced.push_back(node);
+    });
+    for (named_block_node* node : unreferenced)
+        delete node;
 
     // Remove this node from graph's map list.
     if (next)
@@ -9403,7 +10118,7 @@ struct named_block_ref_node : noncopyable
                 {
                     if (!node->manual_delete)
                     {
-                        node->map->blocks.erase(&node->id.get());
+                        node->map->erase(node);
                         delete node;
                     }
                     else
@@ -9423,6 +10138,18 @@ struct named_block_ref_node : noncopyable
 
     // next node in linked list
     named_block_ref_node* next = nullptr;
+
+    // These are also allocated from the graph's node allocator.
+    static void*
+    operator new(std::size_t size, data_node_allocator& allocator)
+    {
+        return allocator.allocate(size);
+    }
+    static void
+    operator delete(void* p, std::size_t size)
+    {
+        data_node_allocator::deallocate(p, size);
+    }
 };
 
 static void
@@ -9446,36 +10173,55 @@ deactivate(named_block_ref_node& ref)
     }
 }
 
+// The following utilities process lists in reverse order (to match general C++
+// semantics). Lists can be very long (e.g., the named blocks in a for_each
+// over a large container), so rather than recursing, they reverse the list in
+// place, walk it and (if the list is still needed) reverse it again.
+
+template<class Node>
+static Node*
+reverse_list(Node* head)
+{
+    Node* reversed = nullptr;
+    while (head)
+    {
+        Node* next = head->next;
+        head->next = reversed;
+        reversed = head;
+        head = next;
+    }
+    return reversed;
+}
+
 static void
 delete_named_block_ref_list(named_block_ref_node* head)
 {
-    if (head)
+    named_block_ref_node* node = reverse_list(head);
+    while (node)
     {
-        delete_named_block_ref_list(head->next);
-        delete head;
+        named_block_ref_node* next = node->next;
+        delete node;
+        node = next;
     }
 }
 
-// Clear node caches in reverse order to match general C++ semantics.
 static void
-clear_data_node_caches(data_node* node)
+clear_data_node_caches(data_node* head)
 {
-    if (node)
-    {
-        clear_data_node_caches(node->next);
+    data_node* reversed = reverse_list(head);
+    for (data_node* node = reversed; node; node = node->next)
         node->clear_cache();
-    }
+    reverse_list(reversed);
 }
 
 // Same with named_block_ref_nodes.
 static void
-deactivate_ref_nodes(named_block_ref_node* node)
+deactivate_ref_nodes(named_block_ref_node* head)
 {
-    if (node)
-    {
-        deactivate_ref_nodes(node->next);
+    named_block_ref_node* reversed = reverse_list(head);
+    for (named_block_ref_node* node = reversed; node; node = node->next)
         deactivate(*node);
-    }
+    reverse_list(reversed);
 }
 
 void
@@ -9494,14 +10240,115 @@ data_block::~data_block()
     clear_data_block(*this);
 }
 
-// Delete nodes in reverse order to match general C++ semantics.
+struct data_node_allocator::slab_header
+{
+    data_node_allocator* allocator;
+    slab_header* next;
+};
+
+// Get the size class for a node of the given size.
+// (Anything beyond the last size class goes directly to the heap.)
+static std::size_t
+get_size_class(std::size_t size)
+{
+    return (size - 1) / data_node_allocator::slot_granularity;
+}
+
+data_node_allocator::~data_node_allocator()
+{
+    assert(live_node_count == 0);
+    while (slabs_)
+    {
+        slab_header* next = slabs_->next;
+        ::operator delete(slabs_, std::align_val_t(slab_size));
+        slabs_ = next;
+    }
+}
+
+void
+data_node_allocator::add_slab()
+{
+    // the offset of the first slot within a slab
+    constexpr std::size_t header_size
+        = (sizeof(slab_header) + slot_granularity - 1) / slot_granularity
+          * slot_granularity;
+
+    void* memory = ::operator new(slab_size, std::align_val_t(slab_size));
+    slab_header* slab = static_cast<slab_header*>(memory);
+    slab->allocator = this;
+    slab->next = slabs_;
+    slabs_ = slab;
+    slab_cursor_ = static_cast<char*>(memory) + header_size;
+    slab_end_ = static_cast<char*>(memory) + slab_size;
+    ++slab_count;
+}
+
+void*
+data_node_allocator::allocate(std::size_t size)
+{
+    std::size_t size_class = get_size_class(size);
+    if (size_class >= size_class_count)
+        return ::operator new(size);
+
+    ++live_node_count;
+
+    free_slot*& free_list = free_lists_[size_class];
+    if (free_list)
+    {
+        free_slot* slot = free_list;
+        free_list = slot->next;
+        return slot;
+    }
+
+    std::size_t slot_size = (size_class + 1) * slot_granularity;
+    if (std::size_t(slab_end_ - slab_cursor_) < slot_size)
+    {
+        // Before moving on to a new slab, put the rest of this one on the free
+        // list for its size so that it isn't wasted. (Everything here is a
+        // multiple of slot_granularity, so it fits a size class exactly.)
+        if (slab_cursor_ != slab_end_)
+        {
+            free_slot* rest = reinterpret_cast<free_slot*>(slab_cursor_);
+            free_slot*& list
+                = free_lists_[get_size_class(slab_end_ - slab_cursor_)];
+            rest->next = list;
+            list = rest;
+        }
+        add_slab();
+    }
+    void* slot = slab_cursor_;
+    slab_cursor_ += slot_size;
+    return slot;
+}
+
+void
+data_node_allocator::deallocate(void* p, std::size_t size)
+{
+    std::size_t size_class = get_size_class(size);
+    if (size_class >= size_class_count)
+    {
+        ::operator delete(p);
+        return;
+    }
+
+    slab_header* slab = reinterpret_cast<slab_header*>(
+        reinterpret_cast<std::uintptr_t>(p) & ~std::uintptr_t(slab_size - 1));
+    data_node_allocator& allocator = *slab->allocator;
+    free_slot* slot = static_cast<free_slot*>(p);
+    slot->next = allocator.free_lists_[size_class];
+    allocator.free_lists_[size_class] = slot;
+    --allocator.live_node_count;
+}
+
 static void
-clear_data_nodes(data_node* node)
+clear_data_nodes(data_node* head)
 {
-    if (node)
+    data_node* node = reverse_list(head);
+    while (node)
     {
-        clear_data_nodes(node->next);
+        data_node* next = node->next;
         delete node;
+        node = next;
     }
 }
 
@@ -9529,12 +10376,14 @@ scoped_data_block::begin(data_traversal& traversal, data_block& block)
 
     old_active_block_ = traversal.active_block;
     old_predicted_named_block_ = traversal.predicted_named_block;
+    old_skipped_named_blocks_ = traversal.skipped_named_blocks;
     old_used_named_blocks_ = traversal.used_named_blocks;
     old_named_block_next_ptr_ = traversal.named_block_next_ptr;
     old_next_data_ptr_ = traversal.next_data_ptr;
 
     traversal.active_block = &block;
     traversal.predicted_named_block = block.named_blocks;
+    traversal.skipped_named_blocks = 0;
     traversal.used_named_blocks = 0;
     traversal.named_block_next_ptr = &traversal.used_named_blocks;
     traversal.next_data_ptr = &block.nodes;
@@ -9554,10 +10403,26 @@ scoped_data_block::end()
         {
             traversal.active_block->named_blocks = traversal.used_named_blocks;
             delete_named_block_ref_list(traversal.predicted_named_block);
+            delete_named_block_ref_list(traversal.skipped_named_blocks);
+        }
+        else if (traversal.gc_enabled)
+        {
+            // The traversal was interrupted, so it's not known which blocks
+            // are still needed. The references that it used have been moved
+            // off of the block's list (and the ones that it skipped), so put
+            // them all back together (used, then skipped, then the rest) and
+            // leave it to the next complete traversal to sort out.
+            named_block_ref_node** tail = traversal.named_block_next_ptr;
+            *tail = traversal.skipped_named_blocks;
+            while (*tail)
+                tail = &(*tail)->next;
+            *tail = traversal.predicted_named_block;
+            traversal.active_block->named_blocks = traversal.used_named_blocks;
         }
 
         traversal.active_block = old_active_block_;
         traversal.predicted_named_block = old_predicted_named_block_;
+        traversal.skipped_named_blocks = old_skipped_named_blocks_;
         traversal.used_named_blocks = old_used_named_blocks_;
         traversal.named_block_next_ptr = old_named_block_next_ptr_;
         traversal.next_data_ptr = old_next_data_ptr_;
@@ -9599,6 +10464,35 @@ record_usage(data_traversal& traversal, named_block_ref_node* ref)
     activate(*ref);
 }
 
+// When the predicted block isn't the one that's requested, find_named_block()
+// looks this many references further down the predicted list (and into the
+// skipped list) before resorting to the map. This lets prediction resynchronize
+// after a few blocks are inserted, removed or moved (e.g., in a for_each over a
+// container that's been edited), and it lets the existing references be reused
+// rather than replaced.
+static constexpr int named_block_lookahead = 8;
+
+static bool
+references_block(
+    named_block_ref_node const* ref,
+    naming_map const& map,
+    id_interface const& id)
+{
+    return ref->node->id.get() == id && ref->node->map == &map;
+}
+
+// (This is the same check, but it compares hashes first to rule out most
+// mismatches cheaply.)
+static bool
+references_block(
+    named_block_ref_node const* ref,
+    naming_map const& map,
+    id_interface const& id,
+    std::size_t hash)
+{
+    return ref->node->id_hash == hash && references_block(ref, map, id);
+}
+
 static named_block_node*
 find_named_block(
     data_traversal& traversal,
@@ -9609,8 +10503,7 @@ find_named_block(
     // If the sequence of data requests is the same as last pass (which it
     // generally is), then the block we're looking for is the predicted one.
     named_block_ref_node* predicted = traversal.predicted_named_block;
-    if (predicted && predicted->node->id.get() == id
-        && predicted->node->map == &map)
+    if (predicted && references_block(predicted, map, id))
     {
         traversal.predicted_named_block = predicted->next;
         if (traversal.gc_enabled)
@@ -9621,28 +10514,65 @@ find_named_block(
     if (!traversal.gc_enabled)
         throw named_block_out_of_order();
 
+    std::size_t hash = id.hash();
+
+    // Look a little further down the predicted list. If the block is there,
+    // the ones before it are moved to the skipped list and prediction picks up
+    // again after it.
+    if (predicted)
+    {
+        named_block_ref_node* last_skipped = predicted;
+        for (int i = 0; i != named_block_lookahead && last_skipped->next; ++i)
+        {
+            named_block_ref_node* ref = last_skipped->next;
+            if (references_block(ref, map, id, hash))
+            {
+                last_skipped->next = traversal.skipped_named_blocks;
+                traversal.skipped_named_blocks = predicted;
+                traversal.predicted_named_block = ref->next;
+                record_usage(traversal, ref);
+                return ref->node;
+            }
+            last_skipped = ref;
+        }
+    }
+
+    // Check the most recently skipped references.
+    {
+        named_block_ref_node** link = &traversal.skipped_named_blocks;
+        for (int i = 0; i != named_block_lookahead && *link; ++i)
+        {
+            named_block_ref_node* ref = *link;
+            if (references_block(ref, map, id, hash))
+            {
+                *link = ref->next;
+                record_usage(traversal, ref);
+                return ref->node;
+            }
+            link = &ref->next;
+        }
+    }
+
     // Otherwise, look it up in the map.
-    naming_map::map_type::const_iterator i = map.blocks.find(&id);
+    named_block_node* node = map.find(id, hash);
 
     // If it's not already in the map, create it and insert it.
-    if (i == map.blocks.end())
+    if (!node)
     {
-        named_block_node* new_node = new named_block_node;
-        new_node->id.capture(id);
-        new_node->map = &map;
-        new_node->manual_delete = manual.value;
-        i = map.blocks
-                .insert(naming_map::map_type::value_type(
-                    &new_node->id.get(), new_node))
-                .first;
+        node = new (traversal.graph->node_allocator) named_block_node;
+        node->id.capture(id);
+        node->id_hash = hash;
+        node->map = &map;
+        node->manual_delete = manual.value;
+        map.insert(node);
     }
 
-    named_block_node* node = i->second;
     assert(node && node->map == &map);
 
     // Create a new reference node to record the node's usage within this
     // data_block.
-    named_block_ref_node* ref = new named_block_ref_node;
+    named_block_ref_node* ref
+        = new (traversal.graph->node_allocator) named_block_ref_node;
     ref->node = node;
     ref->active = false;
     ++node->reference_count;
@@ -9672,10 +10602,9 @@ delete_named_block(data_graph& graph, id_interface const& id)
 {
     for (naming_map_node* i = graph.map_list; i; i = i->next)
     {
-        naming_map::map_type::const_iterator j = i->map.blocks.find(&id);
-        if (j != i->map.blocks.end())
+        named_block_node* node = i->map.find(id, id.hash());
+        if (node)
         {
-            named_block_node* node = j->second;
             // If the reference count is nonzero, the block is still active,
             // so we don't want to delete it. We just want to clear the
             // manual_delete flag.
@@ -9685,7 +10614,7 @@ delete_named_block(data_graph& graph, id_interface const& id)
             }
             else
             {
-                i->map.blocks.erase(&id);
+                i->map.erase(node);
                 node->map = 0;
                 delete node;
             }
@@ -10051,11 +10980,26 @@ refresh_system(system& sys)
     };
 }
 
+void
+request_refresh(system& sys)
+{
+    if (sys.external)
+        sys.external->request_refresh();
+    else
+        refresh_system(sys);
+}
+
 } // namespace alia
 
 
 namespace alia {
 
+void
+default_external_interface::request_refresh()
+{
+    refresh_system(this->owner);
+}
+
 millisecond_count
 default_external_interface::get_tick_count() const
 {
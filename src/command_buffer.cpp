@@ -0,0 +1,806 @@
+#include "command_buffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <charconv>
+#include <cstring>
+#include <deque>
+#include <string_view>
+#include <unordered_map>
+
+namespace dom {
+
+mutation_counts
+operator-(mutation_counts const& a, mutation_counts const& b)
+{
+    mutation_counts d;
+    d.created_elements = a.created_elements - b.created_elements;
+    d.created_text_nodes = a.created_text_nodes - b.created_text_nodes;
+    d.insertions = a.insertions - b.insertions;
+    d.removals = a.removals - b.removals;
+    d.attribute_sets = a.attribute_sets - b.attribute_sets;
+    d.attribute_removals = a.attribute_removals - b.attribute_removals;
+    d.property_sets = a.property_sets - b.property_sets;
+    d.property_removals = a.property_removals - b.property_removals;
+    d.node_value_sets = a.node_value_sets - b.node_value_sets;
+    d.style_changes = a.style_changes - b.style_changes;
+    d.class_changes = a.class_changes - b.class_changes;
+    d.string_bytes = a.string_bytes - b.string_bytes;
+    return d;
+}
+
+command_buffer&
+get_command_buffer()
+{
+    static command_buffer the_buffer;
+    return the_buffer;
+}
+
+static std::vector<int> free_node_ids;
+static int next_node_id = 1;
+
+int
+allocate_node_id()
+{
+    if (!free_node_ids.empty())
+    {
+        int id = free_node_ids.back();
+        free_node_ids.pop_back();
+        return id;
+    }
+    return next_node_id++;
+}
+
+void
+release_node_id(command_buffer& buffer, int id)
+{
+    buffer.released_ids.push_back(id);
+}
+
+void
+flush_commands(command_buffer& buffer)
+{
+    resolve_node_removals(buffer);
+    if (!buffer.words.empty())
+    {
+        if (buffer.executor)
+            buffer.executor(buffer.words.data(), buffer.words.size());
+        buffer.words.clear();
+    }
+    // Now that the removals have actually been carried out, the IDs can be
+    // handed out again.
+    free_node_ids.insert(
+        free_node_ids.end(),
+        buffer.released_ids.begin(),
+        buffer.released_ids.end());
+    buffer.released_ids.clear();
+}
+
+static void
+write_word(command_buffer& buffer, std::uint32_t word)
+{
+    buffer.words.push_back(word);
+}
+
+static void
+count_mutation(mutation_counts& counts, command_code code)
+{
+    switch (code)
+    {
+        case command_code::CREATE_ELEMENT:
+        case command_code::CLONE_TEMPLATE:
+            ++counts.created_elements;
+            break;
+        case command_code::CREATE_TEXT_NODE:
+            ++counts.created_text_nodes;
+            break;
+        case command_code::INSERT_BEFORE:
+            ++counts.insertions;
+            break;
+        case command_code::REMOVE_CHILD:
+        case command_code::DETACH_NODE:
+            ++counts.removals;
+            break;
+        case command_code::SET_ATTRIBUTE:
+            ++counts.attribute_sets;
+            break;
+        case command_code::REMOVE_ATTRIBUTE:
+            ++counts.attribute_removals;
+            break;
+        case command_code::SET_STRING_PROPERTY:
+        case command_code::SET_NUMBER_PROPERTY:
+        case command_code::SET_BOOLEAN_PROPERTY:
+            ++counts.property_sets;
+            break;
+        case command_code::REMOVE_PROPERTY:
+            ++counts.property_removals;
+            break;
+        case command_code::SET_NODE_VALUE:
+        case command_code::SET_NODE_NUMBER:
+            ++counts.node_value_sets;
+            break;
+        case command_code::SET_STYLE:
+        case command_code::SET_STYLE_NUMBER:
+        case command_code::SET_STYLE_COLOR:
+        case command_code::REMOVE_STYLE:
+            ++counts.style_changes;
+            break;
+        case command_code::ADD_CLASS:
+        case command_code::REMOVE_CLASS:
+            ++counts.class_changes;
+            break;
+        default:
+            break;
+    }
+}
+
+static void
+write_opcode(command_buffer& buffer, command_code code)
+{
+    count_mutation(buffer.mutations, code);
+    write_word(buffer, std::uint32_t(code));
+}
+
+// Doubles are written as two words, least significant first.
+static void
+write_double(command_buffer& buffer, double value)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    write_word(buffer, std::uint32_t(bits));
+    write_word(buffer, std::uint32_t(bits >> 32));
+}
+
+static void
+write_string(command_buffer& buffer, char const* text)
+{
+    std::size_t length = std::strlen(text);
+    buffer.mutations.string_bytes += length;
+    write_word(buffer, std::uint32_t(length));
+    // Reserve room for the characters plus the null terminator, rounded up to
+    // a whole number of words.
+    std::size_t word_count = (length + 1 + 3) / 4;
+    std::size_t offset = buffer.words.size();
+    buffer.words.resize(offset + word_count, 0);
+    std::memcpy(&buffer.words[offset], text, length);
+}
+
+static void
+finish_command(command_buffer& buffer)
+{
+    if (buffer.immediate)
+        flush_commands(buffer);
+}
+
+namespace {
+
+struct name_table
+{
+    // The names themselves are stored in a deque so that the views in the map
+    // remain valid as it grows.
+    std::deque<std::string> names;
+    std::unordered_map<std::string_view, int> ids;
+};
+
+name_table&
+get_name_table()
+{
+    static name_table the_table;
+    return the_table;
+}
+
+} // namespace
+
+int
+intern_name(char const* name)
+{
+    name_table& table = get_name_table();
+    auto i = table.ids.find(name);
+    if (i != table.ids.end())
+        return i->second;
+
+    int id = int(table.names.size());
+    table.names.push_back(name);
+    table.ids[table.names.back()] = id;
+
+    command_buffer& buffer = get_command_buffer();
+    write_opcode(buffer, command_code::DEFINE_NAME);
+    write_word(buffer, id);
+    write_string(buffer, name);
+    finish_command(buffer);
+
+    return id;
+}
+
+int
+find_interned_name(char const* name)
+{
+    name_table& table = get_name_table();
+    auto i = table.ids.find(name);
+    return i != table.ids.end() ? i->second : -1;
+}
+
+char const*
+get_interned_name(int id)
+{
+    return get_name_table().names[id].c_str();
+}
+
+void
+encode_create_element(command_buffer& buffer, int id, int tag)
+{
+    write_opcode(buffer, command_code::CREATE_ELEMENT);
+    write_word(buffer, id);
+    write_word(buffer, tag);
+    finish_command(buffer);
+}
+
+void
+encode_create_text_node(command_buffer& buffer, int id, char const* text)
+{
+    write_opcode(buffer, command_code::CREATE_TEXT_NODE);
+    write_word(buffer, id);
+    write_string(buffer, text);
+    finish_command(buffer);
+}
+
+void
+encode_insert_before(command_buffer& buffer, int parent, int child, int before)
+{
+    write_opcode(buffer, command_code::INSERT_BEFORE);
+    write_word(buffer, parent);
+    write_word(buffer, child);
+    write_word(buffer, before);
+    finish_command(buffer);
+}
+
+void
+encode_remove_child(command_buffer& buffer, int id)
+{
+    write_opcode(buffer, command_code::REMOVE_CHILD);
+    write_word(buffer, id);
+    release_node_id(buffer, id);
+    finish_command(buffer);
+}
+
+void
+queue_node_removal(command_buffer& buffer, int id, int parent)
+{
+    buffer.queued_removals.push_back({id, parent});
+    finish_command(buffer);
+}
+
+void
+resolve_node_removals(command_buffer& buffer)
+{
+    if (buffer.queued_removals.empty())
+        return;
+
+    // Take the queue first, since encoding can trigger a flush (in immediate
+    // mode), which would resolve it again.
+    std::vector<queued_removal> removals;
+    std::swap(removals, buffer.queued_removals);
+
+    static std::vector<int> removed_ids;
+    removed_ids.clear();
+    for (auto const& removal : removals)
+        removed_ids.push_back(removal.id);
+    std::sort(removed_ids.begin(), removed_ids.end());
+
+    // Remove the topmost nodes first so that the others are already out of
+    // the DOM when they're released.
+    auto parent_is_removed = [&](queued_removal const& removal) {
+        return removal.parent < 0
+               || std::binary_search(
+                   removed_ids.begin(), removed_ids.end(), removal.parent);
+    };
+    for (auto const& removal : removals)
+    {
+        if (!parent_is_removed(removal))
+        {
+            write_opcode(buffer, command_code::REMOVE_CHILD);
+            write_word(buffer, removal.id);
+            release_node_id(buffer, removal.id);
+        }
+    }
+    for (auto const& removal : removals)
+    {
+        if (parent_is_removed(removal))
+        {
+            write_opcode(buffer, command_code::RELEASE_NODE);
+            write_word(buffer, removal.id);
+            release_node_id(buffer, removal.id);
+        }
+    }
+
+    // Reuse the queue's storage.
+    removals.clear();
+    if (buffer.queued_removals.empty())
+        std::swap(removals, buffer.queued_removals);
+}
+
+void
+encode_detach_node(command_buffer& buffer, int id)
+{
+    write_opcode(buffer, command_code::DETACH_NODE);
+    write_word(buffer, id);
+    finish_command(buffer);
+}
+
+void
+encode_set_attribute(
+    command_buffer& buffer, int id, int name, char const* value)
+{
+    write_opcode(buffer, command_code::SET_ATTRIBUTE);
+    write_word(buffer, id);
+    write_word(buffer, name);
+    write_string(buffer, value);
+    finish_command(buffer);
+}
+
+void
+encode_remove_attribute(command_buffer& buffer, int id, int name)
+{
+    write_opcode(buffer, command_code::REMOVE_ATTRIBUTE);
+    write_word(buffer, id);
+    write_word(buffer, name);
+    finish_command(buffer);
+}
+
+void
+encode_set_node_value(command_buffer& buffer, int id, char const* text)
+{
+    write_opcode(buffer, command_code::SET_NODE_VALUE);
+    write_word(buffer, id);
+    write_string(buffer, text);
+    finish_command(buffer);
+}
+
+void
+encode_set_node_number(
+    command_buffer& buffer,
+    int id,
+    double value,
+    int precision,
+    bool grouping)
+{
+    write_opcode(buffer, command_code::SET_NODE_NUMBER);
+    write_word(buffer, id);
+    write_word(
+        buffer,
+        (precision < 0 ? 0xffu : std::uint32_t(precision) & 0xffu)
+            | (grouping ? 0x100u : 0u));
+    write_double(buffer, value);
+    finish_command(buffer);
+}
+
+void
+encode_set_string_property(
+    command_buffer& buffer, int id, int name, char const* value)
+{
+    write_opcode(buffer, command_code::SET_STRING_PROPERTY);
+    write_word(buffer, id);
+    write_word(buffer, name);
+    write_string(buffer, value);
+    finish_command(buffer);
+}
+
+void
+encode_set_number_property(
+    command_buffer& buffer, int id, int name, double value)
+{
+    write_opcode(buffer, command_code::SET_NUMBER_PROPERTY);
+    write_word(buffer, id);
+    write_word(buffer, name);
+    write_double(buffer, value);
+    finish_command(buffer);
+}
+
+void
+encode_set_boolean_property(
+    command_buffer& buffer, int id, int name, bool value)
+{
+    write_opcode(buffer, command_code::SET_BOOLEAN_PROPERTY);
+    write_word(buffer, id);
+    write_word(buffer, name);
+    write_word(buffer, value ? 1 : 0);
+    finish_command(buffer);
+}
+
+void
+encode_remove_property(command_buffer& buffer, int id, int name)
+{
+    write_opcode(buffer, command_code::REMOVE_PROPERTY);
+    write_word(buffer, id);
+    write_word(buffer, name);
+    finish_command(buffer);
+}
+
+void
+encode_delegate_events(command_buffer& buffer, int id, int event_type)
+{
+    write_opcode(buffer, command_code::DELEGATE_EVENTS);
+    write_word(buffer, id);
+    write_word(buffer, event_type);
+    finish_command(buffer);
+}
+
+void
+encode_set_style(command_buffer& buffer, int id, int name, char const* value)
+{
+    write_opcode(buffer, command_code::SET_STYLE);
+    write_word(buffer, id);
+    write_word(buffer, name);
+    write_string(buffer, value);
+    finish_command(buffer);
+}
+
+void
+encode_set_style_number(
+    command_buffer& buffer, int id, int name, double value, int unit)
+{
+    write_opcode(buffer, command_code::SET_STYLE_NUMBER);
+    write_word(buffer, id);
+    write_word(buffer, name);
+    write_word(buffer, unit);
+    write_double(buffer, value);
+    finish_command(buffer);
+}
+
+void
+encode_set_style_color(
+    command_buffer& buffer,
+    int id,
+    int name,
+    std::uint8_t r,
+    std::uint8_t g,
+    std::uint8_t b)
+{
+    write_opcode(buffer, command_code::SET_STYLE_COLOR);
+    write_word(buffer, id);
+    write_word(buffer, name);
+    write_word(buffer, (std::uint32_t(r) << 16) | (std::uint32_t(g) << 8) | b);
+    finish_command(buffer);
+}
+
+void
+encode_remove_style(command_buffer& buffer, int id, int name)
+{
+    write_opcode(buffer, command_code::REMOVE_STYLE);
+    write_word(buffer, id);
+    write_word(buffer, name);
+    finish_command(buffer);
+}
+
+void
+encode_add_class(command_buffer& buffer, int id, int name)
+{
+    write_opcode(buffer, command_code::ADD_CLASS);
+    write_word(buffer, id);
+    write_word(buffer, name);
+    finish_command(buffer);
+}
+
+void
+encode_remove_class(command_buffer& buffer, int id, int name)
+{
+    write_opcode(buffer, command_code::REMOVE_CLASS);
+    write_word(buffer, id);
+    write_word(buffer, name);
+    finish_command(buffer);
+}
+
+void
+encode_define_template(
+    command_buffer& buffer, int template_id, char const* html)
+{
+    write_opcode(buffer, command_code::DEFINE_TEMPLATE);
+    write_word(buffer, template_id);
+    write_string(buffer, html);
+    finish_command(buffer);
+}
+
+void
+encode_clone_template(command_buffer& buffer, int id, int template_id)
+{
+    write_opcode(buffer, command_code::CLONE_TEMPLATE);
+    write_word(buffer, id);
+    write_word(buffer, template_id);
+    finish_command(buffer);
+}
+
+void
+encode_begin_hydration(command_buffer& buffer, int id)
+{
+    write_opcode(buffer, command_code::BEGIN_HYDRATION);
+    write_word(buffer, id);
+    finish_command(buffer);
+}
+
+void
+encode_end_hydration(command_buffer& buffer, int id)
+{
+    write_opcode(buffer, command_code::END_HYDRATION);
+    write_word(buffer, id);
+    finish_command(buffer);
+}
+
+void
+encode_configure_node_pool(command_buffer& buffer, std::size_t capacity)
+{
+    write_opcode(buffer, command_code::CONFIGURE_NODE_POOL);
+    write_word(buffer, 0);
+    write_word(buffer, std::uint32_t(capacity));
+    finish_command(buffer);
+}
+
+namespace {
+
+struct command_reader
+{
+    std::uint32_t const* words;
+    std::size_t size;
+    std::size_t position = 0;
+
+    bool
+    done() const
+    {
+        return position >= size;
+    }
+
+    std::uint32_t
+    read_word()
+    {
+        assert(position < size);
+        return words[position++];
+    }
+
+    int
+    read_int()
+    {
+        return int(read_word());
+    }
+
+    char const*
+    read_name(command_handler& handler)
+    {
+        std::size_t id = read_word();
+        assert(id < handler.names.size());
+        return handler.names[id].c_str();
+    }
+
+    double
+    read_double()
+    {
+        std::uint64_t bits = read_word();
+        bits |= std::uint64_t(read_word()) << 32;
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    char const*
+    read_string()
+    {
+        std::size_t length = read_word();
+        char const* text = reinterpret_cast<char const*>(words + position);
+        position += (length + 1 + 3) / 4;
+        assert(position <= size);
+        return text;
+    }
+};
+
+} // namespace
+
+// Format a number the way the JS side does. (This matches JS exactly for
+// values within a sensible range.)
+static std::string
+format_number(double value, std::uint32_t format = 0xff)
+{
+    char text[400];
+    int precision = int(format & 0xff);
+    auto result
+        = precision == 0xff
+              ? std::to_chars(text, text + sizeof(text), value)
+              : std::to_chars(
+                  text,
+                  text + sizeof(text),
+                  value,
+                  std::chars_format::fixed,
+                  precision);
+    std::string formatted(text, result.ptr);
+    if (format & 0x100)
+    {
+        std::size_t end = formatted.find('.');
+        if (end == std::string::npos)
+            end = formatted.size();
+        std::size_t start = formatted[0] == '-' ? 1 : 0;
+        for (std::size_t i = end; i > start + 3; i -= 3)
+            formatted.insert(i - 3, 1, ',');
+    }
+    return formatted;
+}
+
+void
+decode_commands(
+    std::uint32_t const* words, std::size_t size, command_handler& handler)
+{
+    command_reader reader{words, size};
+    while (!reader.done())
+    {
+        switch (command_code(reader.read_word()))
+        {
+            case command_code::CREATE_ELEMENT: {
+                int id = reader.read_int();
+                char const* tag = reader.read_name(handler);
+                handler.create_element(id, tag);
+                break;
+            }
+            case command_code::CREATE_TEXT_NODE: {
+                int id = reader.read_int();
+                char const* text = reader.read_string();
+                handler.create_text_node(id, text);
+                break;
+            }
+            case command_code::INSERT_BEFORE: {
+                int parent = reader.read_int();
+                int child = reader.read_int();
+                int before = reader.read_int();
+                handler.insert_before(parent, child, before);
+                break;
+            }
+            case command_code::REMOVE_CHILD: {
+                handler.remove_child(reader.read_int());
+                break;
+            }
+            case command_code::DETACH_NODE: {
+                handler.detach_node(reader.read_int());
+                break;
+            }
+            case command_code::RELEASE_NODE: {
+                handler.release_node(reader.read_int());
+                break;
+            }
+            case command_code::SET_ATTRIBUTE: {
+                int id = reader.read_int();
+                char const* name = reader.read_name(handler);
+                char const* value = reader.read_string();
+                handler.set_attribute(id, name, value);
+                break;
+            }
+            case command_code::REMOVE_ATTRIBUTE: {
+                int id = reader.read_int();
+                char const* name = reader.read_name(handler);
+                handler.remove_attribute(id, name);
+                break;
+            }
+            case command_code::SET_NODE_VALUE: {
+                int id = reader.read_int();
+                char const* text = reader.read_string();
+                handler.set_node_value(id, text);
+                break;
+            }
+            case command_code::DEFINE_NAME: {
+                std::size_t id = reader.read_word();
+                char const* name = reader.read_string();
+                if (handler.names.size() <= id)
+                    handler.names.resize(id + 1);
+                handler.names[id] = name;
+                break;
+            }
+            case command_code::DELEGATE_EVENTS: {
+                int id = reader.read_int();
+                char const* event_type = reader.read_name(handler);
+                handler.delegate_events(id, event_type);
+                break;
+            }
+            case command_code::SET_STYLE: {
+                int id = reader.read_int();
+                char const* name = reader.read_name(handler);
+                char const* value = reader.read_string();
+                handler.set_style(id, name, value);
+                break;
+            }
+            case command_code::SET_STYLE_NUMBER: {
+                int id = reader.read_int();
+                char const* name = reader.read_name(handler);
+                char const* unit = reader.read_name(handler);
+                double value = reader.read_double();
+                handler.set_style(
+                    id, name, (format_number(value) + unit).c_str());
+                break;
+            }
+            case command_code::SET_STYLE_COLOR: {
+                int id = reader.read_int();
+                char const* name = reader.read_name(handler);
+                std::uint32_t rgb = reader.read_word();
+                std::string value = "rgb(" + std::to_string(rgb >> 16) + ", "
+                                    + std::to_string((rgb >> 8) & 0xff) + ", "
+                                    + std::to_string(rgb & 0xff) + ")";
+                handler.set_style(id, name, value.c_str());
+                break;
+            }
+            case command_code::REMOVE_STYLE: {
+                int id = reader.read_int();
+                char const* name = reader.read_name(handler);
+                handler.remove_style(id, name);
+                break;
+            }
+            case command_code::SET_NODE_NUMBER: {
+                int id = reader.read_int();
+                std::uint32_t format = reader.read_word();
+                double value = reader.read_double();
+                handler.set_node_value(
+                    id, format_number(value, format).c_str());
+                break;
+            }
+            case command_code::ADD_CLASS: {
+                int id = reader.read_int();
+                handler.add_class(id, reader.read_name(handler));
+                break;
+            }
+            case command_code::REMOVE_CLASS: {
+                int id = reader.read_int();
+                handler.remove_class(id, reader.read_name(handler));
+                break;
+            }
+            case command_code::DEFINE_TEMPLATE: {
+                int template_id = reader.read_int();
+                char const* html = reader.read_string();
+                handler.define_template(template_id, html);
+                break;
+            }
+            case command_code::CLONE_TEMPLATE: {
+                int id = reader.read_int();
+                int template_id = reader.read_int();
+                handler.clone_template(id, template_id);
+                break;
+            }
+            case command_code::BEGIN_HYDRATION: {
+                handler.begin_hydration(reader.read_int());
+                break;
+            }
+            case command_code::END_HYDRATION: {
+                handler.end_hydration(reader.read_int());
+                break;
+            }
+            case command_code::SET_STRING_PROPERTY: {
+                int id = reader.read_int();
+                char const* name = reader.read_name(handler);
+                char const* value = reader.read_string();
+                handler.set_string_property(id, name, value);
+                break;
+            }
+            case command_code::SET_NUMBER_PROPERTY: {
+                int id = reader.read_int();
+                char const* name = reader.read_name(handler);
+                double value = reader.read_double();
+                handler.set_number_property(id, name, value);
+                break;
+            }
+            case command_code::SET_BOOLEAN_PROPERTY: {
+                int id = reader.read_int();
+                char const* name = reader.read_name(handler);
+                bool value = reader.read_word() != 0;
+                handler.set_boolean_property(id, name, value);
+                break;
+            }
+            case command_code::REMOVE_PROPERTY: {
+                int id = reader.read_int();
+                char const* name = reader.read_name(handler);
+                handler.remove_property(id, name);
+                break;
+            }
+            case command_code::CONFIGURE_NODE_POOL: {
+                reader.read_word();
+                handler.configure_node_pool(reader.read_word());
+                break;
+            }
+            default:
+                assert(0 && "invalid DOM command");
+                return;
+        }
+    }
+}
+
+} // namespace dom
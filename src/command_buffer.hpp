@@ -0,0 +1,459 @@
+#ifndef COMMAND_BUFFER_HPP
+#define COMMAND_BUFFER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// This file defines the command buffer that sits between the DOM layer and
+// whatever is actually hosting the DOM (normally JavaScript).
+//
+// Crossing the wasm/JS boundary is expensive, so rather than issuing a call for
+// every DOM mutation, the DOM layer encodes mutations into a linear buffer of
+// 32-bit words as it goes. The buffer is then flushed in one go (normally at
+// the end of a traversal), and a single interpreter loop on the other side
+// decodes and applies all of it.
+//
+// The encoding is intentionally simple. Each command is an opcode word
+// followed by its arguments. Integers occupy one word. Strings are encoded as
+// a word holding their length in bytes, followed by their UTF-8 bytes, a null
+// terminator and enough padding to reach the next word boundary. (The null
+// terminator is there so that the JS side can decode strings directly out of
+// wasm memory with UTF8ToString.)
+//
+// Node IDs are allocated on this side (since creating a node doesn't round-trip
+// to JS anymore). ID 0 is reserved to mean "no node".
+//
+// Tag, attribute, property and event names are interned. The first time a name
+// is used, it's assigned a small integer ID and a DEFINE_NAME command is
+// emitted so that the other side can record it in a matching lookup table.
+// After that, only the ID crosses the boundary.
+
+namespace dom {
+
+enum class command_code : std::uint32_t
+{
+    // CREATE_ELEMENT id tag_name_id
+    CREATE_ELEMENT = 1,
+    // CREATE_TEXT_NODE id text
+    CREATE_TEXT_NODE,
+    // INSERT_BEFORE parent child before
+    INSERT_BEFORE,
+    // REMOVE_CHILD id
+    REMOVE_CHILD,
+    // SET_ATTRIBUTE id name_id value
+    SET_ATTRIBUTE,
+    // REMOVE_ATTRIBUTE id name_id
+    REMOVE_ATTRIBUTE,
+    // SET_NODE_VALUE id text
+    SET_NODE_VALUE,
+    // DEFINE_NAME name_id name
+    DEFINE_NAME,
+    // DELEGATE_EVENTS id event_type_name_id
+    DELEGATE_EVENTS,
+    // BEGIN_HYDRATION id
+    BEGIN_HYDRATION,
+    // END_HYDRATION id
+    END_HYDRATION,
+    // SET_STYLE id name_id value
+    SET_STYLE,
+    // SET_STYLE_NUMBER id name_id unit_name_id value_low value_high
+    // (The value is a double, split into two words, least significant first.)
+    SET_STYLE_NUMBER,
+    // SET_STYLE_COLOR id name_id rgb
+    // (The color is packed into the low 24 bits as 0xRRGGBB.)
+    SET_STYLE_COLOR,
+    // REMOVE_STYLE id name_id
+    REMOVE_STYLE,
+    // ADD_CLASS id class_name_id
+    ADD_CLASS,
+    // REMOVE_CLASS id class_name_id
+    REMOVE_CLASS,
+    // SET_NODE_NUMBER id format value_low value_high
+    // (The value is encoded as with SET_STYLE_NUMBER. The format holds the
+    // precision in its low 8 bits and the grouping flag in bit 8.)
+    SET_NODE_NUMBER,
+    // CONFIGURE_NODE_POOL 0 capacity
+    // (The ID word is unused.)
+    CONFIGURE_NODE_POOL,
+    // SET_STRING_PROPERTY id name_id value
+    SET_STRING_PROPERTY,
+    // SET_NUMBER_PROPERTY id name_id value_low value_high
+    // (The value is encoded as with SET_STYLE_NUMBER.)
+    SET_NUMBER_PROPERTY,
+    // SET_BOOLEAN_PROPERTY id name_id value
+    SET_BOOLEAN_PROPERTY,
+    // REMOVE_PROPERTY id name_id
+    REMOVE_PROPERTY,
+    // DETACH_NODE id
+    DETACH_NODE,
+    // DEFINE_TEMPLATE template_id html
+    DEFINE_TEMPLATE,
+    // CLONE_TEMPLATE id template_id
+    CLONE_TEMPLATE,
+    // RELEASE_NODE id
+    // (This forgets a node that's already gone because an ancestor was
+    // removed. Unlike REMOVE_CHILD, it doesn't touch the DOM itself.)
+    RELEASE_NODE,
+};
+
+// counts of the DOM mutations that have been encoded into a buffer
+struct mutation_counts
+{
+    // elements created (including those cloned from templates)
+    std::uint64_t created_elements = 0;
+    std::uint64_t created_text_nodes = 0;
+    // INSERT_BEFORE commands (i.e., both initial placements and relocations)
+    std::uint64_t insertions = 0;
+    // nodes removed or detached
+    std::uint64_t removals = 0;
+    std::uint64_t attribute_sets = 0;
+    std::uint64_t attribute_removals = 0;
+    // property sets and removals (including untyped ones)
+    std::uint64_t property_sets = 0;
+    std::uint64_t property_removals = 0;
+    // text node values set (as strings or numbers)
+    std::uint64_t node_value_sets = 0;
+    // changes to inline styles and class lists
+    std::uint64_t style_changes = 0;
+    std::uint64_t class_changes = 0;
+    // the number of bytes of string data encoded (excluding length words and
+    // padding)
+    std::uint64_t string_bytes = 0;
+};
+
+mutation_counts
+operator-(mutation_counts const& a, mutation_counts const& b);
+
+// a node removal that hasn't been encoded yet (see queue_node_removal())
+struct queued_removal
+{
+    int id;
+    // the node's parent at the time (or 0 if it wasn't in the DOM, or -1 if
+    // the parent has already been removed)
+    int parent;
+};
+
+struct command_buffer
+{
+    // the encoded commands
+    std::vector<std::uint32_t> words;
+
+    // IDs of nodes that were removed by the commands currently in the buffer -
+    // These can't be reused until the buffer has been executed.
+    std::vector<int> released_ids;
+
+    // removals that have been queued but not yet encoded
+    std::vector<queued_removal> queued_removals;
+
+    // This is invoked to actually execute the contents of the buffer.
+    std::function<void(std::uint32_t const* words, std::size_t size)> executor;
+
+    // If this is set, the buffer is flushed after every command. This is
+    // mostly useful for debugging, since it gives you the old behavior of
+    // mutations being visible immediately.
+    bool immediate = false;
+
+    // running totals of the mutations encoded into this buffer
+    // (These are never reset. Take differences to measure an interval.)
+    mutation_counts mutations;
+};
+
+// Get the command buffer that the DOM layer encodes into.
+command_buffer&
+get_command_buffer();
+
+// Execute everything that's currently in the buffer (and then clear it).
+void
+flush_commands(command_buffer& buffer);
+
+inline void
+flush_commands()
+{
+    flush_commands(get_command_buffer());
+}
+
+// Allocate/release node IDs.
+int
+allocate_node_id();
+void
+release_node_id(command_buffer& buffer, int id);
+
+// Get the ID associated with the given name.
+// If this is the first time that the name has been seen, this also encodes a
+// command to define it on the other side (so it must be called before the ID
+// is used in any other command).
+int
+intern_name(char const* name);
+
+// Get the ID associated with the given name without interning it.
+// If the name hasn't been interned, this returns -1 (and encodes nothing).
+int
+find_interned_name(char const* name);
+
+// Get the name associated with an interned ID.
+char const*
+get_interned_name(int id);
+
+void
+encode_create_element(command_buffer& buffer, int id, int tag);
+
+void
+encode_create_text_node(command_buffer& buffer, int id, char const* text);
+
+void
+encode_insert_before(command_buffer& buffer, int parent, int child, int before);
+
+void
+encode_remove_child(command_buffer& buffer, int id);
+
+// Remove a node (destroying it), like encode_remove_child(), but defer the
+// actual encoding until resolve_node_removals() is called. (flush_commands()
+// does this first.) :parent is the ID of the node's current parent (or 0 if
+// it's not in the DOM, or -1 if the parent has already been removed).
+//
+// This is for tearing down large subtrees. Their nodes are destroyed from the
+// bottom up, so when a node is removed, it's not yet known whether its parent
+// is going too. By the time the removals are resolved, it is: only the nodes
+// whose parents are staying are actually removed from the DOM, and the rest
+// (which went along with them) are just released.
+void
+queue_node_removal(command_buffer& buffer, int id, int parent);
+
+void
+resolve_node_removals(command_buffer& buffer);
+
+// Take a node out of its parent without destroying it (unlike REMOVE_CHILD).
+// It can be inserted again later.
+void
+encode_detach_node(command_buffer& buffer, int id);
+
+void
+encode_set_attribute(
+    command_buffer& buffer, int id, int name, char const* value);
+
+void
+encode_remove_attribute(command_buffer& buffer, int id, int name);
+
+void
+encode_set_node_value(command_buffer& buffer, int id, char const* text);
+
+// Set the value of a text node to a number. The number is formatted on the
+// other side, with :precision digits after the decimal point (or, if
+// :precision is negative, as JS would format it by default). If :grouping is
+// set, the digits before the decimal point are grouped in threes, separated
+// by commas.
+void
+encode_set_node_number(
+    command_buffer& buffer,
+    int id,
+    double value,
+    int precision,
+    bool grouping);
+
+// Set/remove a property of a node directly (i.e., node[name] = value and
+// delete node[name]). The other side tracks which properties have been set on
+// each node so that it can clear them if the node is recycled.
+void
+encode_set_string_property(
+    command_buffer& buffer, int id, int name, char const* value);
+void
+encode_set_number_property(
+    command_buffer& buffer, int id, int name, double value);
+void
+encode_set_boolean_property(
+    command_buffer& buffer, int id, int name, bool value);
+void
+encode_remove_property(command_buffer& buffer, int id, int name);
+
+// Install a listener on the given node that delegates all events of the given
+// type (within the node's subtree) back to the DOM layer.
+// (See dom.hpp for details.)
+void
+encode_delegate_events(command_buffer& buffer, int id, int event_type);
+
+// Set/remove individual properties of a node's inline style (i.e.,
+// style.setProperty() and style.removeProperty()).
+// Numbers and colors are formatted on the other side, as <value><unit> and
+// "rgb(r, g, b)" respectively.
+void
+encode_set_style(command_buffer& buffer, int id, int name, char const* value);
+void
+encode_set_style_number(
+    command_buffer& buffer, int id, int name, double value, int unit);
+void
+encode_set_style_color(
+    command_buffer& buffer,
+    int id,
+    int name,
+    std::uint8_t r,
+    std::uint8_t g,
+    std::uint8_t b);
+void
+encode_remove_style(command_buffer& buffer, int id, int name);
+
+// Add/remove a class in a node's class list (i.e., classList.add() and
+// classList.remove()). Class names are interned like any other name.
+void
+encode_add_class(command_buffer& buffer, int id, int name);
+void
+encode_remove_class(command_buffer& buffer, int id, int name);
+
+// Templates are static pieces of content that are defined once (as HTML with
+// a single root element) and then instantiated by cloning them. Template IDs
+// are separate from node IDs.
+void
+encode_define_template(
+    command_buffer& buffer, int template_id, char const* html);
+void
+encode_clone_template(command_buffer& buffer, int id, int template_id);
+
+// Hydration is the process of adopting existing (e.g., server-rendered)
+// content rather than creating it from scratch. Between BEGIN_HYDRATION and
+// END_HYDRATION, nodes that are created and then appended to a node within
+// the given subtree adopt the next existing child (if it matches) instead.
+// Any existing children that haven't been adopted by the end are removed.
+//
+// Since this works by matching up insertions with existing children, it's
+// only valid while building content in order (i.e., during the initial
+// refresh), and nodes must be inserted before anything else is done with
+// them.
+void
+encode_begin_hydration(command_buffer& buffer, int id);
+void
+encode_end_hydration(command_buffer& buffer, int id);
+
+// Node pooling lets the other side recycle removed elements rather than
+// leaving them to the garbage collector. When it's enabled, a removed element
+// is stripped (of its attributes, properties, listeners and children) and kept
+// in a pool for its tag, and creating an element of that tag takes one from
+// the pool if possible. :capacity is the maximum number of elements kept per
+// tag. A capacity of 0 disables pooling, and any change empties the pools.
+//
+// Elements that delegate events are never pooled.
+void
+encode_configure_node_pool(command_buffer& buffer, std::size_t capacity);
+
+struct node_pool_stats
+{
+    // the number of elements that were taken from a pool
+    std::uint64_t hits = 0;
+    // the number of elements that had to be created (while pooling was
+    // enabled) because the pool for their tag was empty
+    std::uint64_t misses = 0;
+    // the number of elements currently in the pools
+    std::uint64_t size = 0;
+};
+
+// The following is a native decoder for the command stream. It's used by
+// non-JS hosts and is also useful for inspecting and benchmarking the encoding
+// itself.
+//
+// The decoder takes care of tracking name definitions, so handlers are always
+// given the actual names.
+
+struct command_handler
+{
+    virtual ~command_handler()
+    {
+    }
+
+    virtual void
+    create_element(int id, char const* tag)
+        = 0;
+
+    virtual void
+    create_text_node(int id, char const* text)
+        = 0;
+
+    virtual void
+    insert_before(int parent, int child, int before) = 0;
+
+    virtual void
+    remove_child(int id) = 0;
+
+    virtual void
+    detach_node(int id) = 0;
+
+    virtual void
+    release_node(int id) = 0;
+
+    virtual void
+    set_attribute(int id, char const* name, char const* value)
+        = 0;
+
+    virtual void
+    remove_attribute(int id, char const* name)
+        = 0;
+
+    virtual void
+    set_node_value(int id, char const* text)
+        = 0;
+
+    virtual void
+    set_string_property(int id, char const* name, char const* value)
+        = 0;
+
+    virtual void
+    set_number_property(int id, char const* name, double value)
+        = 0;
+
+    virtual void
+    set_boolean_property(int id, char const* name, bool value)
+        = 0;
+
+    virtual void
+    remove_property(int id, char const* name)
+        = 0;
+
+    virtual void
+    delegate_events(int id, char const* event_type)
+        = 0;
+
+    virtual void
+    set_style(int id, char const* name, char const* value)
+        = 0;
+
+    virtual void
+    remove_style(int id, char const* name)
+        = 0;
+
+    virtual void
+    add_class(int id, char const* name)
+        = 0;
+
+    virtual void
+    remove_class(int id, char const* name)
+        = 0;
+
+    virtual void
+    define_template(int template_id, char const* html)
+        = 0;
+
+    virtual void
+    clone_template(int id, int template_id) = 0;
+
+    virtual void
+    begin_hydration(int id) = 0;
+
+    virtual void
+    end_hydration(int id) = 0;
+
+    virtual void
+    configure_node_pool(std::size_t capacity) = 0;
+
+    // the names defined so far in the stream, indexed by ID
+    std::vector<std::string> names;
+};
+
+// Decode the given command stream, invoking the appropriate method on :handler
+// for each command.
+void
+decode_commands(
+    std::uint32_t const* words, std::size_t size, command_handler& handler);
+
+} // namespace dom
+
+#endif
@@ -1,61 +1,227 @@
 #include "dom.hpp"
+#include "html.hpp"
 
-#include <emscripten/bind.h>
-#include <emscripten/emscripten.h>
-#include <emscripten/val.h>
-
-#include <chrono>
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
 
 namespace dom {
 
-void
-callback_proxy(std::uintptr_t callback, emscripten::val event)
+namespace {
+
+struct delegated_handler
 {
-    (*reinterpret_cast<std::function<void(emscripten::val)>*>(callback))(event);
+    alia::system* system;
+    component_id component;
+    event_coalescing coalescing;
 };
 
-EMSCRIPTEN_BINDINGS(callback_proxy)
+// the table of delegated event handlers, keyed by node ID and event type
+// (Since node IDs are unique across all systems, one table serves them all.)
+typedef std::unordered_multimap<std::uint64_t, delegated_handler>
+    delegated_handler_table;
+
+delegated_handler_table&
+get_delegated_handlers()
 {
-    emscripten::function(
-        "callback_proxy", &callback_proxy, emscripten::allow_raw_pointers());
+    static delegated_handler_table the_table;
+    return the_table;
+}
+
+std::uint64_t
+make_handler_key(int node, int event_type)
+{
+    return (std::uint64_t(std::uint32_t(node)) << 32)
+           | std::uint32_t(event_type);
+}
+
+// events that are being held for delivery at the next frame, grouped by the
+// component that they're targeted at
+struct held_events
+{
+    alia::system* system;
+    external_component_id target;
+    std::vector<js_value> events;
 };
 
+std::vector<held_events>&
+get_held_events()
+{
+    static std::vector<held_events> the_list;
+    return the_list;
+}
+
+// Deliver the events that are being held (either all of them or just the ones
+// for :only).
+void
+deliver_held_events(alia::system* only = nullptr)
+{
+    auto& all_held = get_held_events();
+    std::vector<held_events> held;
+    if (!only)
+    {
+        std::swap(held, all_held);
+    }
+    else
+    {
+        auto split = std::stable_partition(
+            all_held.begin(), all_held.end(), [&](auto const& group) {
+                return group.system != only;
+            });
+        held.assign(
+            std::make_move_iterator(split),
+            std::make_move_iterator(all_held.end()));
+        all_held.erase(split, all_held.end());
+    }
+    std::vector<alia::system*> systems;
+    for (auto& group : held)
+    {
+        dom_event e;
+        e.events = std::move(group.events);
+        e.target_id = group.target.id;
+        impl::dispatch_targeted_event(*group.system, e, group.target.identity);
+        if (std::find(systems.begin(), systems.end(), group.system)
+            == systems.end())
+        {
+            systems.push_back(group.system);
+        }
+    }
+    // Each affected system only needs to be refreshed once.
+    for (auto* system : systems)
+        request_refresh(*system);
+}
+
+void
+hold_event(delegated_handler const& handler, js_value event)
+{
+    auto& held = get_held_events();
+    if (held.empty())
+        schedule_frame_task([]() { deliver_held_events(); });
+    auto group = std::find_if(held.begin(), held.end(), [&](auto const& g) {
+        return g.target.id == handler.component;
+    });
+    if (group == held.end())
+    {
+        held.push_back(
+            held_events{handler.system, externalize(handler.component), {}});
+        group = held.end() - 1;
+    }
+    if (handler.coalescing == event_coalescing::LATEST)
+        group->events.clear();
+    group->events.push_back(event);
+}
+
+} // namespace
+
 void
 install_element_callback(
     context ctx,
     element_object& object,
     callback_data& data,
-    char const* event_type)
-{
-    auto external_id = externalize(&data.identity);
-    auto* system = &get<system_tag>(ctx);
-    data.callback = [=](emscripten::val v) {
-        dom_event event(v);
-        dispatch_targeted_event(*system, event, external_id);
-    };
-    EM_ASM_(
+    char const* event_type,
+    event_coalescing coalescing)
+{
+    int type_id = intern_name(event_type);
+
+    // Make sure the system's root is listening for this type of event.
+    dom::system& system = get<dom_system_tag>(ctx);
+    auto& types = system.delegated_event_types;
+    if (std::find(types.begin(), types.end(), type_id) == types.end())
+    {
+        types.push_back(type_id);
+        encode_delegate_events(
+            get_command_buffer(), system.root_node.object.js_id, type_id);
+    }
+
+    data.node = object.js_id;
+    data.event_type = type_id;
+    data.coalescing = coalescing;
+    get_delegated_handlers().emplace(
+        make_handler_key(object.js_id, type_id),
+        delegated_handler{&get<system_tag>(ctx), &data.identity, coalescing});
+}
+
+callback_data::~callback_data()
+{
+    if (this->node == 0)
+        return;
+    auto& handlers = get_delegated_handlers();
+    auto range
+        = handlers.equal_range(make_handler_key(this->node, this->event_type));
+    for (auto i = range.first; i != range.second; ++i)
+    {
+        if (i->second.component == &this->identity)
         {
-            var element = Module.nodes[$0];
-            var type = Module['UTF8ToString']($2);
-            var handler = function(e)
-            {
-                var start = window.performance.now();
-                Module.callback_proxy($1, e);
-                var end = window.performance.now();
-                console.log(
-                    "total event time: " + (((end - start) * 1000) | 0)
-                    + " µs");
-            };
-            element.addEventListener(type, handler);
-            // Add the handler to asm-dom's event list so that it knows to clear
-            // it out before recycling this DOM node.
-            if (!element.hasOwnProperty('asmDomEvents'))
-                element['asmDomEvents'] = {};
-            element['asmDomEvents'][type] = handler;
-        },
-        object.js_id,
-        reinterpret_cast<std::uintptr_t>(&data.callback),
-        event_type);
+            handlers.erase(i);
+            break;
+        }
+    }
+    // Drop any events that are still being held for this callback.
+    if (this->coalescing != event_coalescing::IMMEDIATE)
+    {
+        auto& held = get_held_events();
+        held.erase(
+            std::remove_if(
+                held.begin(),
+                held.end(),
+                [&](auto const& group) {
+                    return group.target.id == &this->identity;
+                }),
+            held.end());
+    }
+}
+
+bool
+dispatch_delegated_event(int node, int event_type, js_value event)
+{
+    auto& handlers = get_delegated_handlers();
+    auto range = handlers.equal_range(make_handler_key(node, event_type));
+    if (range.first == range.second)
+        return false;
+    // Dispatching an event can change the table, so work from a copy.
+    std::vector<delegated_handler> matches;
+    for (auto i = range.first; i != range.second; ++i)
+        matches.push_back(i->second);
+    for (auto const& handler : matches)
+    {
+        if (handler.coalescing != event_coalescing::IMMEDIATE
+            && has_frame_clock())
+        {
+            hold_event(handler, event);
+            continue;
+        }
+        // Anything that the system is still holding happened before this
+        // event, so it has to be delivered first. (Otherwise, e.g., a click
+        // on a submit button wouldn't see the latest 'input' events.)
+        deliver_held_events(handler.system);
+        dom_event e;
+        e.events.push_back(event);
+        auto component = externalize(handler.component);
+        if (!is_event_latency_tracking_enabled())
+        {
+            dispatch_targeted_event(*handler.system, e, component);
+            continue;
+        }
+        // This is dispatch_targeted_event() split into its phases.
+        // (Flushes can happen in either phase, so the flush time is tracked
+        // separately and subtracted out of each.)
+        double flush_time_0 = get_total_flush_time();
+        double time_0 = get_latency_timestamp();
+        e.target_id = component.id;
+        impl::dispatch_targeted_event(*handler.system, e, component.identity);
+        double flush_time_1 = get_total_flush_time();
+        double time_1 = get_latency_timestamp();
+        request_refresh(*handler.system);
+        double time_2 = get_latency_timestamp();
+        double flush_time_2 = get_total_flush_time();
+
+        event_latency_sample sample;
+        sample.dispatch = (time_1 - time_0) - (flush_time_1 - flush_time_0);
+        sample.traversal = (time_2 - time_1) - (flush_time_2 - flush_time_1);
+        sample.flush = flush_time_2 - flush_time_0;
+        record_event_latency(event_type, sample);
+    }
+    return true;
 }
 
 struct text_node_data
@@ -77,14 +243,55 @@ text_node_(dom::context ctx, readable<string> text)
             data->value_id,
             text,
             [&](std::string const& new_value) {
-                EM_ASM_(
-                    { Module.setNodeValue($0, Module['UTF8ToString']($1)); },
+                encode_set_node_value(
+                    get_command_buffer(),
                     data->node.object.js_id,
                     new_value.c_str());
             },
             [&]() {
-                EM_ASM_(
-                    { Module.setNodeValue($0, ""); }, data->node.object.js_id);
+                encode_set_node_value(
+                    get_command_buffer(), data->node.object.js_id, "");
+            });
+    }
+}
+
+struct number_node_data
+{
+    tree_node<element_object> node;
+    captured_id value_id;
+    number_format format;
+};
+
+void
+number_node_(dom::context ctx, readable<double> value, number_format format)
+{
+    number_node_data* data;
+    if (get_cached_data(ctx, &data))
+        data->node.object.create_as_text_node("");
+    if (is_refresh_event(ctx))
+    {
+        refresh_tree_node(get<tree_traversal_tag>(ctx), data->node);
+        // If the format changes, the value has to be sent again.
+        if (format.precision != data->format.precision
+            || format.grouping != data->format.grouping)
+        {
+            data->value_id.clear();
+            data->format = format;
+        }
+        refresh_signal_shadow(
+            data->value_id,
+            value,
+            [&](double new_value) {
+                encode_set_node_number(
+                    get_command_buffer(),
+                    data->node.object.js_id,
+                    new_value,
+                    format.precision,
+                    format.grouping);
+            },
+            [&]() {
+                encode_set_node_value(
+                    get_command_buffer(), data->node.object.js_id, "");
             });
     }
 }
@@ -102,22 +309,15 @@ do_element_attribute(
             stored_id,
             value,
             [&](string const& new_value) {
-                EM_ASM_(
-                    {
-                        Module.setAttribute(
-                            $0,
-                            Module['UTF8ToString']($1),
-                            Module['UTF8ToString']($2));
-                    },
+                encode_set_attribute(
+                    get_command_buffer(),
                     object.js_id,
-                    name,
+                    intern_name(name),
                     new_value.c_str());
             },
             [&]() {
-                EM_ASM_(
-                    { Module.removeAttribute($0, Module['UTF8ToString']($1)); },
-                    object.js_id,
-                    name);
+                encode_remove_attribute(
+                    get_command_buffer(), object.js_id, intern_name(name));
             });
     });
 }
@@ -134,26 +334,16 @@ do_element_attribute(
             [&](bool new_value) {
                 if (new_value)
                 {
-                    EM_ASM_(
-                        {
-                            Module.setAttribute(
-                                $0,
-                                Module['UTF8ToString']($1),
-                                Module['UTF8ToString']($2));
-                        },
+                    encode_set_attribute(
+                        get_command_buffer(),
                         object.js_id,
-                        name,
+                        intern_name(name),
                         "");
                 }
                 else
                 {
-                    EM_ASM_(
-                        {
-                            Module.removeAttribute(
-                                $0, Module['UTF8ToString']($1));
-                        },
-                        object.js_id,
-                        name);
+                    encode_remove_attribute(
+                        get_command_buffer(), object.js_id, intern_name(name));
                 }
             },
             [&]() {});
@@ -161,43 +351,132 @@ do_element_attribute(
 }
 
 void
-set_element_property(
-    element_object& object, char const* name, emscripten::val value)
+set_element_style(
+    element_object& object, char const* name, string const& value)
 {
-    emscripten::val::global("window")["asmDomHelpers"]["nodes"][object.js_id]
-        .set(name, value);
+    encode_set_style(
+        get_command_buffer(), object.js_id, intern_name(name), value.c_str());
+}
 
-    // Add the property name to the element's 'asmDomRaws' list. asm-dom uses
-    // this to track what it needs to clean up when recycling a DOM node.
-    EM_ASM_(
-        {
-            var element = Module.nodes[$0];
-            if (!element.hasOwnProperty('asmDomRaws'))
-                element['asmDomRaws'] = [];
-            element['asmDomRaws'].push(Module['UTF8ToString']($1));
-        },
+void
+set_element_style(element_object& object, char const* name, rgb8 value)
+{
+    encode_set_style_color(
+        get_command_buffer(),
         object.js_id,
-        name);
+        intern_name(name),
+        value.r,
+        value.g,
+        value.b);
 }
 
 void
-clear_element_property(element_object& object, char const* name)
+set_element_style(
+    element_object& object, char const* name, double value, char const* unit)
 {
-    EM_ASM_(
-        {
-            var node = Module.nodes[$0];
-            delete node[$1];
-
-            // Remove the property name from the element's 'asmDomRaws' list.
-            var asmDomRaws = node['asmDomRaws'];
-            var index = asmDomRaws.indexOf(Module['UTF8ToString']($1));
-            if (index > -1)
-            {
-                asmDomRaws.splice(index, 1);
-            }
-        },
+    encode_set_style_number(
+        get_command_buffer(),
         object.js_id,
-        name);
+        intern_name(name),
+        value,
+        intern_name(unit));
+}
+
+void
+clear_element_style(element_object& object, char const* name)
+{
+    encode_remove_style(get_command_buffer(), object.js_id, intern_name(name));
+}
+
+void
+do_element_class(
+    context ctx, element_object& object, char const* name, readable<bool> flag)
+{
+    auto& stored_id = get_cached_data<captured_id>(ctx);
+    on_refresh(ctx, [&](auto ctx) {
+        refresh_signal_shadow(
+            stored_id,
+            flag,
+            [&](bool new_value) {
+                if (new_value)
+                {
+                    encode_add_class(
+                        get_command_buffer(), object.js_id, intern_name(name));
+                }
+                else
+                {
+                    encode_remove_class(
+                        get_command_buffer(), object.js_id, intern_name(name));
+                }
+            },
+            [&]() {
+                encode_remove_class(
+                    get_command_buffer(), object.js_id, intern_name(name));
+            });
+    });
+}
+
+struct element_classes_data
+{
+    captured_id value_id;
+    // the classes that are currently applied (as interned names)
+    std::vector<int> classes;
+};
+
+static void
+update_element_classes(
+    element_object& object,
+    element_classes_data& data,
+    std::vector<int> const& new_classes)
+{
+    auto& buffer = get_command_buffer();
+    for (int name : data.classes)
+    {
+        if (std::find(new_classes.begin(), new_classes.end(), name)
+            == new_classes.end())
+        {
+            encode_remove_class(buffer, object.js_id, name);
+        }
+    }
+    for (int name : new_classes)
+    {
+        if (std::find(data.classes.begin(), data.classes.end(), name)
+            == data.classes.end())
+        {
+            encode_add_class(buffer, object.js_id, name);
+        }
+    }
+    data.classes = new_classes;
+}
+
+void
+do_element_classes(
+    context ctx, element_object& object, readable<string> classes)
+{
+    auto& data = get_cached_data<element_classes_data>(ctx);
+    on_refresh(ctx, [&](auto ctx) {
+        refresh_signal_shadow(
+            data.value_id,
+            classes,
+            [&](string const& new_value) {
+                std::vector<int> new_classes;
+                std::size_t i = 0;
+                while (true)
+                {
+                    i = new_value.find_first_not_of(' ', i);
+                    if (i == string::npos)
+                        break;
+                    std::size_t end = new_value.find(' ', i);
+                    if (end == string::npos)
+                        end = new_value.size();
+                    new_classes.push_back(
+                        intern_name(new_value.substr(i, end - i).c_str()));
+                    i = end;
+                }
+                update_element_classes(object, data, new_classes);
+            },
+            [&]() { update_element_classes(object, data, {}); });
+    });
 }
 
 struct input_data
@@ -233,18 +512,20 @@ input_(dom::context ctx, duplex<string> value_)
         }
     });
 
+    bool invalid = value.is_invalidated();
     element(ctx, "input")
-        .attr(
-            "class",
-            conditional(
-                value.is_invalidated(), "invalid-input", "form-control"))
+        .class_if("invalid-input", invalid)
+        .class_if("form-control", !invalid)
         .prop("value", data->value)
-        .callback("input", [=](emscripten::val& e) {
-            auto new_value = e["target"]["value"].as<std::string>();
-            write_signal(value, new_value);
-            data->value = new_value;
-            ++data->version;
-        });
+        .callback(
+            "input",
+            [=](js_value& e) {
+                auto new_value = e["target"]["value"].as<std::string>();
+                write_signal(value, new_value);
+                data->value = new_value;
+                ++data->version;
+            },
+            event_coalescing::LATEST);
 }
 
 void
@@ -274,7 +555,7 @@ checkbox_(dom::context ctx, duplex<bool> value, readable<std::string> label)
                 .attr("id", "custom-check-1")
                 .prop("indeterminate", !determinate)
                 .prop("checked", checked)
-                .callback("change", [&](emscripten::val e) {
+                .callback("change", [&](js_value e) {
                     write_signal(value, e["target"]["checked"].as<bool>());
                 });
             element(ctx, "label")
@@ -293,7 +574,7 @@ link_(dom::context ctx, readable<std::string> text, action<> on_click)
             .attr("disabled", on_click.is_ready() ? "false" : "true")
             .children([&](auto ctx) { text_node(ctx, text); })
             .callback(
-                "click", [&](emscripten::val) { perform_action(on_click); });
+                "click", [&](js_value) { perform_action(on_click); });
     });
 }
 
@@ -302,126 +583,229 @@ colored_box(dom::context ctx, readable<rgb8> color)
 {
     element(ctx, "div")
         .attr("class", "colored-box")
-        .attr(
-            "style",
-            printf(
-                ctx,
-                "background-color: #%02x%02x%02x",
-                alia_field(color, r),
-                alia_field(color, g),
-                alia_field(color, b)));
+        .style("background-color", color);
 }
 
-static void
-refresh_for_emscripten(void* system)
+static_node
+static_element(
+    std::string tag,
+    std::vector<std::pair<std::string, std::string>> attributes,
+    std::vector<static_node> children)
 {
-    refresh_system(*reinterpret_cast<alia::system*>(system));
+    static_node node;
+    node.tag = std::move(tag);
+    node.attributes = std::move(attributes);
+    node.children = std::move(children);
+    return node;
 }
 
-struct timer_callback_data
+static_node
+static_text(std::string text)
 {
-    alia::system* system;
-    external_component_id component;
-    millisecond_count trigger_time;
-};
+    static_node node;
+    node.text = std::move(text);
+    return node;
+}
 
 static void
-timer_callback(void* user_data)
+write_static_html(std::ostream& out, static_node const& node)
 {
-    std::unique_ptr<timer_callback_data> data(
-        reinterpret_cast<timer_callback_data*>(user_data));
-    timer_event event;
-    event.trigger_time = data->trigger_time;
-    dispatch_targeted_event(*data->system, event, data->component);
+    if (node.tag.empty())
+    {
+        write_escaped_html(out, node.text, false);
+        return;
+    }
+    out << "<" << node.tag;
+    for (auto const& attribute : node.attributes)
+    {
+        out << " " << attribute.first << "=\"";
+        write_escaped_html(out, attribute.second, true);
+        out << "\"";
+    }
+    out << ">";
+    if (is_void_element(node.tag))
+        return;
+    for (auto const& child : node.children)
+        write_static_html(out, child);
+    out << "</" << node.tag << ">";
 }
 
-struct dom_external_interface : default_external_interface
+static_fragment::static_fragment(static_node const& root)
 {
-    dom_external_interface(alia::system& owner)
-        : default_external_interface(owner)
-    {
-    }
+    assert(!root.tag.empty());
+    std::ostringstream html;
+    write_static_html(html, root);
+    this->html = html.str();
+    static int next_template_id = 1;
+    this->template_id = next_template_id++;
+}
 
-    void
-    schedule_animation_refresh()
+void
+static_content(dom::context ctx, static_fragment& fragment)
+{
+    tree_node<element_object>* node;
+    if (get_cached_data(ctx, &node))
     {
-        emscripten_async_call(refresh_for_emscripten, &this->owner, -1);
+        if (!fragment.defined)
+        {
+            encode_define_template(
+                get_command_buffer(),
+                fragment.template_id,
+                fragment.html.c_str());
+            fragment.defined = true;
+        }
+        node->object.create_as_clone(fragment.template_id);
     }
+    if (is_refresh_event(ctx))
+        refresh_tree_node(get<tree_traversal_tag>(ctx), *node);
+}
 
-    void
-    schedule_timer_event(
-        external_component_id component, millisecond_count time)
+void
+detach_kept_alive_content(keep_alive_data& data)
+{
+    // If the head is out of the tree, the content is already detached (or
+    // its parent is gone).
+    if (!data.head || !data.head->prev_)
+        return;
+    tree_node<element_object>* node = data.head;
+    while (true)
     {
-        auto timeout_data
-            = new timer_callback_data{&this->owner, component, time};
-        emscripten_async_call(
-            timer_callback, timeout_data, time - this->get_tick_count());
+        tree_node<element_object>* next = node->next_;
+        node->remove_from_list();
+        node->prev_ = nullptr;
+        node->next_ = nullptr;
+        node->object.detach();
+        if (node == data.last)
+            break;
+        node = next;
     }
-};
+}
+
+void
+schedule_system_timer_event(
+    alia::system& sys,
+    external_component_id component,
+    millisecond_count time)
+{
+    auto& requests = sys.scheduler.requests;
+    requests.erase(
+        std::remove_if(
+            requests.begin(),
+            requests.end(),
+            [&](auto const& request) {
+                return request.component.id == component.id;
+            }),
+        requests.end());
+    schedule_event(sys.scheduler, component, time);
+}
+
+void
+issue_due_timer_events(alia::system& sys, millisecond_count now)
+{
+    bool issued = false;
+    issue_ready_events(
+        sys.scheduler,
+        now,
+        [&](external_component_id component, millisecond_count trigger_time) {
+            timer_event event;
+            event.trigger_time = trigger_time;
+            event.target_id = component.id;
+            impl::dispatch_targeted_event(sys, event, component.identity);
+            issued = true;
+        });
+    if (issued)
+        request_refresh(sys);
+}
+
+static mutation_counts latest_refresh_mutations;
+
+mutation_counts const&
+get_last_refresh_mutations()
+{
+    return latest_refresh_mutations;
+}
 
 void
 system::operator()(alia::context vanilla_ctx)
 {
     tree_traversal<element_object> traversal;
-    auto ctx = vanilla_ctx.add<tree_traversal_tag>(traversal);
+    auto ctx = vanilla_ctx.add<tree_traversal_tag>(traversal)
+                   .add<dom_system_tag>(*this);
+
+    // The content gets its own data block so that whatever it stops using is
+    // collected (and its DOM nodes removed) when that block ends, rather than
+    // after this returns, when the refresh has already been counted and
+    // flushed.
+    data_block* content_block;
+    get_data_node(get_data_traversal(ctx), &content_block);
 
     if (is_refresh_event(ctx))
     {
-        traverse_object_tree(
-            traversal, this->root_node, [&]() { this->controller(ctx); });
+        auto& buffer = get_command_buffer();
+        mutation_counts before = buffer.mutations;
+        traverse_object_tree(traversal, this->root_node, [&]() {
+            scoped_data_block content(ctx, *content_block);
+            this->controller(ctx);
+        });
+        // (This makes sure that the refresh's removals are counted.)
+        resolve_node_removals(buffer);
+        this->last_refresh_mutations = buffer.mutations - before;
+        latest_refresh_mutations = this->last_refresh_mutations;
     }
     else
     {
+        scoped_data_block content(ctx, *content_block);
         this->controller(ctx);
     }
-}
 
-void
-initialize(
-    dom::system& dom_system,
-    alia::system& alia_system,
-    std::string const& dom_node_id,
-    std::function<void(dom::context)> controller)
-{
-    // Initialize asm-dom (once).
-    static bool asmdom_initialized = false;
-    if (!asmdom_initialized)
+    // Apply all the DOM mutations that the traversal generated in one go.
+    if (!this->flush_after_traversal)
+        return;
+    if (is_event_latency_tracking_enabled())
     {
-        asmdom::Config config = asmdom::Config();
-        config.unsafePatch = true;
-        config.clearMemory = true;
-        asmdom::init(config);
-        asmdom_initialized = true;
+        double start_time = get_latency_timestamp();
+        flush_commands();
+        add_flush_time(get_latency_timestamp() - start_time);
     }
-
-    // Initialize the alia::system and hook it up to the dom::system.
-    initialize_system(
-        alia_system,
-        std::ref(dom_system),
-        new dom_external_interface(alia_system));
-    dom_system.controller = std::move(controller);
-
-    // Replace the requested node in the DOM with our virtual DOM.
-    emscripten::val document = emscripten::val::global("document");
-    emscripten::val placeholder
-        = document.call<emscripten::val>("getElementById", dom_node_id);
-    if (placeholder.isNull())
+    else
     {
-        auto msg = dom_node_id + " not found in document";
-        EM_ASM_({ console.error(Module['UTF8ToString']($0)); }, msg.c_str());
-        throw exception(msg);
+        flush_commands();
     }
-    // For now, just create a div to hold all our content.
-    emscripten::val root = document.call<emscripten::val>(
-        "createElement", emscripten::val("div"));
-    placeholder["parentNode"].call<emscripten::val>(
-        "replaceChild", root, placeholder);
-    dom_system.root_node.object.js_id
-        = emscripten::val::global("window")["asmDomHelpers"]["domApi"]
-              .call<int>("addNode", root);
-
-    // Update the virtual DOM.
-    refresh_system(alia_system);
+}
+
+void
+set_element_property(
+    element_object& object, char const* name, std::string const& value)
+{
+    encode_set_string_property(
+        get_command_buffer(), object.js_id, intern_name(name), value.c_str());
+}
+
+void
+set_element_property(element_object& object, char const* name, double value)
+{
+    encode_set_number_property(
+        get_command_buffer(), object.js_id, intern_name(name), value);
+}
+
+void
+set_element_property(element_object& object, char const* name, bool value)
+{
+    encode_set_boolean_property(
+        get_command_buffer(), object.js_id, intern_name(name), value);
+}
+
+void
+clear_element_property(element_object& object, char const* name)
+{
+    encode_remove_property(
+        get_command_buffer(), object.js_id, intern_name(name));
+}
+
+void
+enable_node_pooling(std::size_t capacity)
+{
+    encode_configure_node_pool(get_command_buffer(), capacity);
 }
 
 } // namespace dom
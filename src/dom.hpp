@@ -2,13 +2,28 @@
 #define DOM_HPP
 
 #include "alia.hpp"
-#include "asm-dom.hpp"
 #include "color.hpp"
+#include "command_buffer.hpp"
+#include "event_latency.hpp"
+#include "frame_scheduler.hpp"
 
 #include <functional>
+#include <type_traits>
+#include <vector>
+
+// The DOM layer has two backends: the real DOM (via emscripten) and a headless,
+// in-memory DOM that allows the UI layer to run natively. The headless backend
+// is selected automatically for non-emscripten builds, but it can also be
+// forced by defining DOM_HEADLESS.
+#if !defined(__EMSCRIPTEN__) && !defined(DOM_HEADLESS)
+#define DOM_HEADLESS
+#endif
 
-#include <emscripten/emscripten.h>
+#ifdef DOM_HEADLESS
+#include "headless_dom.hpp"
+#else
 #include <emscripten/val.h>
+#endif
 
 using std::string;
 
@@ -16,24 +31,73 @@ namespace dom {
 
 using namespace alia;
 
+// js_value is the type used to represent JS values (event objects, property
+// values, etc.) in the active backend.
+#ifdef DOM_HEADLESS
+typedef headless_value js_value;
+#else
+typedef emscripten::val js_value;
+#endif
+
 struct element_object;
+struct system;
 
 ALIA_DEFINE_TAGGED_TYPE(tree_traversal_tag, tree_traversal<element_object>&)
+ALIA_DEFINE_TAGGED_TYPE(dom_system_tag, dom::system&)
 
-typedef alia::extend_context_type_t<alia::context, tree_traversal_tag> context;
+typedef alia::extend_context_type_t<
+    alia::context,
+    tree_traversal_tag,
+    dom_system_tag>
+    context;
 
 struct dom_event : targeted_event
 {
-    dom_event(emscripten::val event) : event(event)
-    {
-    }
-    emscripten::val event;
+    // the JS event(s) being delivered
+    // (Coalesced events are delivered together, oldest first.)
+    std::vector<js_value> events;
 };
 
-struct callback_data
+// how a callback handles rapid sequences of events (e.g., 'input',
+// 'mousemove' or 'scroll')
+//
+// Coalesced events are held until the start of the next frame and then
+// delivered to the handler in a single targeted event (followed by a single
+// refresh). Since the JS event has already finished by then, handlers for
+// coalesced events can't use preventDefault(), etc.
+//
+// Coalescing requires a frame clock (see frame_scheduler.hpp). Without one,
+// events are always delivered immediately.
+//
+enum class event_coalescing
+{
+    // Deliver each event as soon as it arrives.
+    IMMEDIATE,
+    // Deliver only the latest event.
+    LATEST,
+    // Deliver all of the events (in order).
+    ACCUMULATE
+};
+
+// Element callbacks are delegated. Rather than installing a listener on every
+// element that has a callback, each dom::system installs a single listener on
+// its root node for each event type that's in use. When an event arrives
+// there, the JS side walks from the event's target up to the root and, for
+// each node along the way, calls dispatch_delegated_event(), which looks up
+// the handler in a table that's keyed by node ID and event type.
+
+struct callback_data : noncopyable
 {
     component_identity identity;
-    std::function<void(emscripten::val)> callback;
+
+    // the node and event type that this callback is registered under
+    // (or 0 if it's not registered)
+    int node = 0;
+    int event_type = 0;
+
+    event_coalescing coalescing = event_coalescing::IMMEDIATE;
+
+    ~callback_data();
 };
 
 void
@@ -41,7 +105,14 @@ install_element_callback(
     context ctx,
     element_object& object,
     callback_data& data,
-    char const* event_type);
+    char const* event_type,
+    event_coalescing coalescing = event_coalescing::IMMEDIATE);
+
+// Dispatch an event to the handler (if any) that's registered for the given
+// node and event type (an interned name).
+// The return value indicates whether or not a handler was found.
+bool
+dispatch_delegated_event(int node, int event_type, js_value event);
 
 struct element_object
 {
@@ -49,17 +120,25 @@ struct element_object
     create_as_element(char const* type)
     {
         assert(this->js_id == 0);
-        this->js_id = EM_ASM_INT(
-            { return Module.createElement(Module['UTF8ToString']($0)); }, type);
+        this->js_id = allocate_node_id();
+        encode_create_element(
+            get_command_buffer(), this->js_id, intern_name(type));
     }
 
     void
     create_as_text_node(char const* value)
     {
         assert(this->js_id == 0);
-        this->js_id = EM_ASM_INT(
-            { return Module.createTextNode(Module['UTF8ToString']($0)); },
-            value);
+        this->js_id = allocate_node_id();
+        encode_create_text_node(get_command_buffer(), this->js_id, value);
+    }
+
+    void
+    create_as_clone(int template_id)
+    {
+        assert(this->js_id == 0);
+        this->js_id = allocate_node_id();
+        encode_clone_template(get_command_buffer(), this->js_id, template_id);
     }
 
     void
@@ -67,21 +146,47 @@ struct element_object
         element_object& parent, element_object* after, element_object* before)
     {
         assert(this->js_id != 0);
-        EM_ASM_(
-            { Module.insertBefore($0, $1, $2); },
+        encode_insert_before(
+            get_command_buffer(),
             parent.js_id,
             this->js_id,
             before ? before->js_id : 0);
+        this->parent_js_id = parent.js_id;
+    }
+
+    // Take the node out of the DOM without destroying it. (It can be put back
+    // with relocate().)
+    void
+    detach()
+    {
+        assert(this->js_id != 0);
+        encode_detach_node(get_command_buffer(), this->js_id);
+        this->parent_js_id = 0;
     }
 
     void
     remove()
     {
         assert(this->js_id != 0);
-        EM_ASM_({ Module.removeChild($0); }, this->js_id);
-        // In asm-dom, removing a child from its parent also destroys it, so we
-        // have to mark it as uninitialized here.
+        // When a whole subtree is torn down, this is called for every node in
+        // it, so the removal is queued. Only the topmost node actually gets
+        // removed from the DOM. (See queue_node_removal().)
+        queue_node_removal(
+            get_command_buffer(), this->js_id, this->parent_js_id);
+        // Removing a node from its parent also destroys it, so we have to mark
+        // it as uninitialized here.
         this->js_id = 0;
+        this->parent_js_id = 0;
+    }
+
+    // This is called when the node's parent has been removed (taking this
+    // node out of the DOM with it), so that when this node is eventually
+    // removed, it's just released.
+    void
+    orphan()
+    {
+        if (this->js_id != 0)
+            this->parent_js_id = -1;
     }
 
     ~element_object()
@@ -93,16 +198,56 @@ struct element_object
     }
 
     int js_id = 0;
+
+    // the ID of the node that this one was last inserted into
+    // (or -1 if that node has since been removed)
+    int parent_js_id = 0;
 };
 
 void
 text_node_(dom::context ctx, readable<string> text);
 
+// how a number_node formats its value
+struct number_format
+{
+    // the number of digits after the decimal point
+    // (If this is negative, the number is formatted as JS would by default.)
+    int precision = -1;
+    // Group the digits before the decimal point in threes, with commas.
+    bool grouping = false;
+};
+
+void
+number_node_(dom::context ctx, readable<double> value, number_format format);
+
+// A number_node is a text node that displays a number. The number itself is
+// passed to JS and formatted there, so it doesn't have to be converted to text
+// (and then decoded again) along the way.
+template<class Number>
+void
+number_node(
+    dom::context ctx, Number number, number_format format = number_format())
+{
+    number_node_(ctx, signal_cast<double>(signalize(number)), format);
+}
+
+// Text nodes are given numbers (rather than text) when the value is numeric.
 template<class Text>
 void
 text_node(dom::context ctx, Text text)
 {
-    text_node_(ctx, as_text(ctx, signalize(text)));
+    auto signal = signalize(text);
+    typedef typename decltype(signal)::value_type value_type;
+    if constexpr (
+        std::is_arithmetic<value_type>::value
+        && !std::is_same<value_type, bool>::value)
+    {
+        number_node(ctx, signal);
+    }
+    else
+    {
+        text_node_(ctx, as_text(ctx, signal));
+    }
 }
 
 void
@@ -119,13 +264,52 @@ do_element_attribute(
     char const* name,
     readable<bool> value);
 
+// Set a property of an element to an arbitrary JS value.
+// This has to flush the command buffer first, so where possible, use one of
+// the typed versions below, which are encoded like any other mutation.
 void
 set_element_property(
-    element_object& object, char const* name, emscripten::val value);
+    element_object& object, char const* name, js_value value);
+
+void
+set_element_property(
+    element_object& object, char const* name, std::string const& value);
+void
+set_element_property(element_object& object, char const* name, double value);
+void
+set_element_property(element_object& object, char const* name, bool value);
 
 void
 clear_element_property(element_object& object, char const* name);
 
+// Set a property from a C++ value, taking the typed path if there is one.
+template<class Value>
+void
+set_element_property_value(
+    element_object& object, char const* name, Value const& value)
+{
+    if constexpr (
+        std::is_same<Value, bool>::value
+        || std::is_same<Value, std::string>::value)
+    {
+        set_element_property(object, name, value);
+    }
+    else if constexpr (std::is_arithmetic<Value>::value)
+    {
+        set_element_property(object, name, double(value));
+    }
+    else
+    {
+        set_element_property(object, name, js_value(value));
+    }
+}
+
+// Read a property of an element.
+// Note that this has to flush the command buffer first, so it's relatively
+// expensive and shouldn't be done routinely.
+js_value
+get_element_property(element_object& object, char const* name);
+
 template<class Value>
 void
 do_element_property(
@@ -137,12 +321,76 @@ do_element_property(
             stored_id,
             value,
             [&](auto const& new_value) {
-                set_element_property(object, name, emscripten::val(new_value));
+                set_element_property_value(object, name, new_value);
             },
             [&]() { clear_element_property(object, name); });
     });
 }
 
+// Set/clear a single property of an element's inline style.
+// Numbers are given a unit (e.g., "px"), which is empty for unitless
+// properties like opacity.
+void
+set_element_style(
+    element_object& object, char const* name, string const& value);
+
+void
+set_element_style(element_object& object, char const* name, rgb8 value);
+
+void
+set_element_style(
+    element_object& object, char const* name, double value, char const* unit);
+
+void
+clear_element_style(element_object& object, char const* name);
+
+// Each style property is tracked separately, so only the properties that
+// actually change are updated in the DOM. Numbers and colors are passed along
+// as such, so they don't have to be formatted as text here.
+template<class Value>
+void
+do_element_style(
+    context ctx,
+    element_object& object,
+    char const* name,
+    Value const& value,
+    char const* unit = "")
+{
+    auto& stored_id = get_cached_data<captured_id>(ctx);
+    on_refresh(ctx, [&](auto ctx) {
+        refresh_signal_shadow(
+            stored_id,
+            value,
+            [&](auto const& new_value) {
+                if constexpr (std::is_arithmetic<
+                                  std::decay_t<decltype(new_value)>>::value)
+                {
+                    set_element_style(object, name, double(new_value), unit);
+                }
+                else
+                {
+                    set_element_style(object, name, new_value);
+                }
+            },
+            [&]() { clear_element_style(object, name); });
+    });
+}
+
+// Classes can also be controlled individually (via classList) rather than by
+// setting the whole 'class' attribute. This way, toggling one class only
+// touches that class.
+
+// Add the class :name to the element while :flag is true.
+void
+do_element_class(
+    context ctx, element_object& object, char const* name, readable<bool> flag);
+
+// Maintain a set of classes (given as a space-separated list). When the list
+// changes, only the classes that were actually added or removed are updated.
+void
+do_element_classes(
+    context ctx, element_object& object, readable<string> classes);
+
 template<class Context>
 struct element_handle : noncopyable
 {
@@ -171,15 +419,56 @@ struct element_handle : noncopyable
         return *this;
     }
 
+    template<class Value>
+    element_handle&
+    style(char const* name, Value value)
+    {
+        do_element_style(ctx_, node_->object, name, signalize(value));
+        return *this;
+    }
+
+    template<class Value>
+    element_handle&
+    style(char const* name, Value value, char const* unit)
+    {
+        do_element_style(ctx_, node_->object, name, signalize(value), unit);
+        return *this;
+    }
+
+    template<class Flag>
+    element_handle&
+    class_if(char const* name, Flag flag)
+    {
+        do_element_class(ctx_, node_->object, name, signalize(flag));
+        return *this;
+    }
+
+    template<class Classes>
+    element_handle&
+    classes(Classes classes)
+    {
+        do_element_classes(ctx_, node_->object, signalize(classes));
+        return *this;
+    }
+
     template<class Function>
     element_handle&
-    callback(char const* event_type, Function&& fn)
+    callback(
+        char const* event_type,
+        Function&& fn,
+        event_coalescing coalescing = event_coalescing::IMMEDIATE)
     {
         auto& data = get_cached_data<callback_data>(ctx_);
         if (initializing_)
-            install_element_callback(ctx_, node_->object, data, event_type);
+        {
+            install_element_callback(
+                ctx_, node_->object, data, event_type, coalescing);
+        }
         on_targeted_event<dom_event>(
-            ctx_, &data.identity, [&](auto ctx, auto& e) { fn(e.event); });
+            ctx_, &data.identity, [&](auto ctx, auto& e) {
+                for (auto& event : e.events)
+                    fn(event);
+            });
         return *this;
     }
 
@@ -195,6 +484,30 @@ struct element_handle : noncopyable
         return *this;
     }
 
+    // This is the same as children(), but it's intended for keyed content
+    // whose order can change (e.g., for_each over a sortable container).
+    // When the children are reordered, it moves as few DOM nodes as possible.
+    template<class Function>
+    element_handle&
+    keyed_children(Function&& fn)
+    {
+        return children([&](auto ctx) {
+            scoped_tree_reconciliation<element_object> reconciliation;
+            if (is_refresh_event(ctx))
+                reconciliation.begin(get<tree_traversal_tag>(ctx));
+            fn(ctx);
+            if (is_refresh_event(ctx))
+            {
+                // Drop the children that weren't visited before reconciling.
+                // Otherwise, they'd be treated as content that follows the
+                // others, and their old positions would force the others to
+                // move.
+                cap_sibling_list(get<tree_traversal_tag>(ctx));
+                reconciliation.end();
+            }
+        });
+    }
+
     template<class Text>
     element_handle&
     text(Text text)
@@ -202,6 +515,12 @@ struct element_handle : noncopyable
         return children([&](auto ctx) { text_node(ctx, text); });
     }
 
+    element_object&
+    object()
+    {
+        return node_->object;
+    }
+
  private:
     Context ctx_;
     tree_node<element_object>* node_;
@@ -263,16 +582,57 @@ struct scoped_element : noncopyable
         return *this;
     }
 
+    template<class Value>
+    scoped_element&
+    style(char const* name, Value value)
+    {
+        do_element_style(*ctx_, node_->object, name, signalize(value));
+        return *this;
+    }
+
+    template<class Value>
+    scoped_element&
+    style(char const* name, Value value, char const* unit)
+    {
+        do_element_style(*ctx_, node_->object, name, signalize(value), unit);
+        return *this;
+    }
+
+    template<class Flag>
+    scoped_element&
+    class_if(char const* name, Flag flag)
+    {
+        do_element_class(*ctx_, node_->object, name, signalize(flag));
+        return *this;
+    }
+
+    template<class Classes>
+    scoped_element&
+    classes(Classes classes)
+    {
+        do_element_classes(*ctx_, node_->object, signalize(classes));
+        return *this;
+    }
+
     template<class Function>
     scoped_element&
-    callback(char const* event_type, Function&& fn)
+    callback(
+        char const* event_type,
+        Function&& fn,
+        event_coalescing coalescing = event_coalescing::IMMEDIATE)
     {
         auto ctx = *ctx_;
         auto& data = get_cached_data<callback_data>(ctx);
         if (initializing_)
-            install_element_callback(ctx, node_->object, data, event_type);
+        {
+            install_element_callback(
+                ctx, node_->object, data, event_type, coalescing);
+        }
         on_targeted_event<dom_event>(
-            ctx, &data.identity, [&](auto ctx, auto& e) { fn(e.event); });
+            ctx, &data.identity, [&](auto ctx, auto& e) {
+                for (auto& event : e.events)
+                    fn(event);
+            });
         return *this;
     }
 
@@ -403,24 +763,350 @@ cached_content(Context ctx, id_interface const& id, Function&& fn)
     ALIA_END
 }
 
+struct keep_alive_data
+{
+    // the top-level nodes of the content, as of the last time that it was
+    // active (or null if there weren't any)
+    tree_node<element_object>* head = nullptr;
+    tree_node<element_object>* last = nullptr;
+};
+
+// Take the content of a keep_alive out of the tree (and the DOM) without
+// destroying it.
+void
+detach_kept_alive_content(keep_alive_data& data);
+
+// keep_alive(ctx, active, fn) is like ALIA_IF(active) { fn(ctx); } ALIA_END,
+// except that while :active is false, the content is kept alive rather than
+// destroyed. Its DOM nodes are detached from the document (but not
+// destroyed), its data isn't cleared, and it isn't traversed at all. When it
+// becomes active again, its nodes are just put back.
+//
+// This is intended for heavy content that's frequently hidden and shown
+// (e.g., tabs). Note that the content doesn't see any events (including
+// refreshes) while it's inactive, so it's effectively frozen.
+template<class Context, class Active, class Function>
+void
+keep_alive(Context ctx, Active const& active, Function&& fn)
+{
+    keep_alive_data* data;
+    get_data(ctx, &data);
+    data_block* block;
+    get_data_node(ctx, &block);
+
+    auto active_signal = signalize(active);
+    if (!(signal_has_value(active_signal) && read_signal(active_signal)))
+    {
+        // Note that the block is deliberately left alone here (rather than
+        // having its cache cleared).
+        if (is_refresh_event(ctx))
+            detach_kept_alive_content(*data);
+        return;
+    }
+
+    scoped_data_block scoped_block(ctx, *block);
+    if (is_refresh_event(ctx))
+    {
+        // Record where the content's nodes end up (as scoped_tree_cacher
+        // does).
+        auto& traversal = get<tree_traversal_tag>(ctx);
+        tree_node<element_object>** predecessor = traversal.next_ptr;
+        fn(ctx);
+        if (traversal.next_ptr == predecessor)
+        {
+            data->head = nullptr;
+            data->last = nullptr;
+        }
+        else
+        {
+            data->head = *predecessor;
+            data->last = traversal.last_sibling;
+        }
+    }
+    else
+    {
+        fn(ctx);
+    }
+}
+
+// Static fragments are pieces of content that never change (e.g., nested
+// divs with literal classes and labels). A fragment is described once, as a
+// tree of static_nodes, and turned into a template on the other side the first
+// time that it's used. Each instance is then created with a single clone and
+// costs one data node (with no attribute or text tracking), regardless of its
+// size.
+//
+// Since the description should only be built once, fragments are normally
+// declared as static variables:
+//
+//   static dom::static_fragment header(dom::static_element(
+//       "div",
+//       {{"class", "header"}},
+//       {dom::static_element("h4", {}, {dom::static_text("Fun!")})}));
+//   static_content(ctx, header);
+//
+// Note that adjacent text nodes are merged (as they would be by the HTML
+// parser).
+
+struct static_node
+{
+    // Text nodes have an empty tag.
+    std::string tag;
+    std::string text;
+    std::vector<std::pair<std::string, std::string>> attributes;
+    std::vector<static_node> children;
+};
+
+static_node
+static_element(
+    std::string tag,
+    std::vector<std::pair<std::string, std::string>> attributes = {},
+    std::vector<static_node> children = {});
+
+static_node
+static_text(std::string text);
+
+struct static_fragment
+{
+    // The root must be an element.
+    explicit static_fragment(static_node const& root);
+
+    // the HTML for the template
+    std::string html;
+
+    int template_id;
+
+    // Has the template been defined on the other side yet?
+    bool defined = false;
+};
+
+// Add an instance of a static fragment to the DOM.
+void
+static_content(dom::context ctx, static_fragment& fragment);
+
+struct virtual_list_data
+{
+    // the scroll position and viewport height of the list (in pixels)
+    double scroll_top = 0;
+    double viewport_height = 0;
+
+    // Has the list been inserted into the DOM (so that it can be measured)?
+    bool inserted = false;
+};
+
+// the number of rows that a virtual list renders beyond each edge of its
+// viewport
+static constexpr std::size_t virtual_list_overscan = 8;
+
+// the viewport height that a virtual list assumes if it can't measure it
+static constexpr double virtual_list_default_viewport_height = 1000;
+
+// virtual_list(ctx, items, row_height, fn) renders a long list of rows while
+// only actually creating the ones that are visible (plus some overscan).
+// The rest of the list is represented by spacer elements.
+//
+// :items is a signal carrying a random-access container. :row_height is the
+// height of each row (in pixels). For each visible item, fn(ctx, index, item)
+// is called to produce the contents of its row.
+//
+// The list scrolls within its own element, so it should be given a height by
+// CSS (e.g., via the 'virtual-list' class).
+//
+// Rows are cached (and reconciled as keyed children), so as the list scrolls,
+// the rows that remain visible are left alone. Row content is refreshed when
+// the items signal changes or when something within the row itself changes.
+template<class Items, class Fn>
+void
+virtual_list(dom::context ctx, Items items, double row_height, Fn&& fn)
+{
+    virtual_list_data* data;
+    get_cached_data(ctx, &data);
+
+    std::size_t item_count
+        = signal_has_value(items) ? read_signal(items).size() : 0;
+
+    auto list = element(ctx, "div");
+
+    // The viewport height isn't known until the list is actually in the DOM,
+    // so measure it on the first refresh after that. (Scroll events keep it
+    // up-to-date after that.)
+    if (is_refresh_event(ctx) && !data->inserted)
+    {
+        if (data->viewport_height == 0)
+        {
+            // This is the initial refresh, so ask for another one.
+            data->viewport_height = -1;
+            schedule_animation_refresh(ctx);
+        }
+        else
+        {
+            data->viewport_height
+                = get_element_property(list.object(), "clientHeight")
+                      .template as<double>();
+            data->inserted = true;
+        }
+    }
+    double viewport_height = data->viewport_height > 0
+                                 ? data->viewport_height
+                                 : virtual_list_default_viewport_height;
+
+    // Determine the range of visible rows.
+    std::size_t first_visible = std::size_t(data->scroll_top / row_height);
+    std::size_t first = first_visible > virtual_list_overscan
+                            ? first_visible - virtual_list_overscan
+                            : 0;
+    std::size_t end = (std::min)(
+        std::size_t((data->scroll_top + viewport_height) / row_height) + 1
+            + virtual_list_overscan,
+        item_count);
+    if (first > end)
+        first = end;
+
+    list.attr("class", "virtual-list")
+        .style("overflow-y", "auto")
+        .callback(
+            "scroll",
+            [&](js_value e) {
+                data->scroll_top = e["target"]["scrollTop"].as<double>();
+                data->viewport_height
+                    = e["target"]["clientHeight"].as<double>();
+                mark_dirty_component(ctx);
+            },
+            event_coalescing::LATEST)
+        .keyed_children([&](auto ctx) {
+            element(ctx, "div").style("height", first * row_height, "px");
+
+            naming_context nc(ctx);
+            for (std::size_t i = first; i != end; ++i)
+            {
+                named_block nb(nc, make_id(i));
+                cached_content(
+                    ctx,
+                    combine_ids(ref(items.value_id()), make_id(i)),
+                    [&](auto ctx) {
+                        element(ctx, "div")
+                            .style("height", row_height, "px")
+                            .children([&](auto ctx) {
+                                fn(ctx, i, read_signal(items)[i]);
+                            });
+                    });
+            }
+
+            element(ctx, "div").style(
+                "height", (item_count - end) * row_height, "px");
+        });
+}
+
+// Timer events are kept in each alia::system's internal scheduler, and the
+// backend only has to arrange to call issue_due_timer_events() when the
+// earliest one is due.
+
+// Schedule a timer event in the system's internal scheduler. A component only
+// ever waits on its latest request, so this replaces any earlier request from
+// the same component.
+void
+schedule_system_timer_event(
+    alia::system& sys,
+    external_component_id component,
+    millisecond_count time);
+
+// Issue all of the system's timer events that are due (as of :now) as a batch
+// and then request a single refresh.
+void
+issue_due_timer_events(alia::system& sys, millisecond_count now);
+
 struct system
 {
     std::function<void(dom::context)> controller;
 
     tree_node<element_object> root_node;
 
+    // the event types that have a delegating listener installed on the root
+    std::vector<int> delegated_event_types;
+
+    // If this is cleared, the DOM mutations that traversals generate are left
+    // in the command buffer for whoever owns the system to flush (e.g., so
+    // that several systems can be flushed together).
+    bool flush_after_traversal = true;
+
+    // the DOM mutations that the most recent refresh pass generated
+    mutation_counts last_refresh_mutations;
+
     alia::system alia_system;
 
     void
     operator()(alia::context ctx);
 };
 
+// Get the DOM mutations that were generated by the most recent refresh pass
+// of any system. (See system::last_refresh_mutations for a particular one.)
+mutation_counts const&
+get_last_refresh_mutations();
+
+// Enable recycling of removed elements, keeping up to :capacity elements per
+// tag. (0 disables it.) This is off by default.
+// See encode_configure_node_pool() for details.
+void
+enable_node_pooling(std::size_t capacity);
+
+node_pool_stats
+get_node_pool_stats();
+
+// Reset the hit/miss counters.
+void
+reset_node_pool_stats();
+
+// Initialize a DOM system and attach it to the element with the given ID.
+//
+// Normally, that element is replaced with a new element that holds the
+// system's content. If :hydrate is set, the element itself is used as the
+// root and its existing children (as produced by render_to_html()) are
+// adopted rather than recreated.
 void
 initialize(
     dom::system& dom_system,
     alia::system& alia_system,
     std::string const& dom_node_id,
-    std::function<void(dom::context)> controller);
+    std::function<void(dom::context)> controller,
+    bool hydrate = false);
+
+// This is the second half of initialize(), for hosts that initialize the
+// alia::system themselves (e.g., to supply their own external interface).
+// It attaches :dom_system to the element with the given ID (as described
+// above) and does the initial refresh.
+void
+attach_system(
+    dom::system& dom_system,
+    alia::system& alia_system,
+    std::string const& dom_node_id,
+    bool hydrate = false);
+
+#ifdef DOM_HEADLESS
+
+// Run :controller once (in a fresh system) and return the HTML that it
+// produces. This is intended to be served as the content of the element that
+// the client later hydrates.
+std::string
+render_to_html(std::function<void(dom::context)> controller);
+
+// Add the equivalent of one of the placeholder elements in index.html (an
+// empty div with the given ID) to the end of the body. (This flushes
+// :buffer, so the buffer's executor must already apply commands to
+// :document.)
+void
+mount_placeholder(
+    headless_document& document, command_buffer& buffer, char const* id);
+
+// Like mount_placeholder(), but the placeholder holds the given HTML (e.g., as
+// produced by render_to_html()), so that it can be hydrated.
+void
+mount_rendered_placeholder(
+    headless_document& document,
+    command_buffer& buffer,
+    char const* id,
+    std::string const& html);
+
+#endif
 
 } // namespace dom
 
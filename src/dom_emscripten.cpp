@@ -0,0 +1,873 @@
+#include "dom.hpp"
+#include "multi_root_host.hpp"
+
+#include "asm-dom.hpp"
+
+#include <emscripten/bind.h>
+#include <emscripten/emscripten.h>
+#include <emscripten/eventloop.h>
+#include <emscripten/html5.h>
+#include <emscripten/val.h>
+
+// This file implements the parts of the DOM layer that are specific to the
+// real (emscripten/JS) backend.
+
+namespace dom {
+
+static bool
+dispatch_delegated_event_from_js(
+    int node, int event_type, emscripten::val event)
+{
+    return dispatch_delegated_event(node, event_type, event);
+}
+
+EMSCRIPTEN_BINDINGS(dispatch_delegated_event)
+{
+    emscripten::function(
+        "dispatch_delegated_event", &dispatch_delegated_event_from_js);
+};
+
+static emscripten::val
+event_latency_sample_to_js(event_latency_sample const& sample)
+{
+    emscripten::val object = emscripten::val::object();
+    object.set("dispatch", sample.dispatch);
+    object.set("traversal", sample.traversal);
+    object.set("flush", sample.flush);
+    return object;
+}
+
+// Get the event latency records as a JS object, keyed by event type.
+// (See event_latency.hpp for the meaning of the fields.)
+static emscripten::val
+get_event_latency_for_js()
+{
+    emscripten::val records = emscripten::val::object();
+    for (auto const& entry : get_event_latency_records())
+    {
+        event_latency_record const& record = entry.second;
+
+        emscripten::val histogram = emscripten::val::array();
+        for (auto count : record.histogram)
+            histogram.call<void>("push", count);
+
+        // Unroll the ring buffer so that the samples are in order.
+        emscripten::val recent = emscripten::val::array();
+        std::size_t n = record.sample_count;
+        std::size_t capacity = event_latency_record::recent_sample_count;
+        for (std::size_t i = n > capacity ? n - capacity : 0; i != n; ++i)
+        {
+            auto const& sample = record.recent[i % capacity];
+            recent.call<void>("push", event_latency_sample_to_js(sample));
+        }
+
+        emscripten::val object = emscripten::val::object();
+        object.set("count", record.sample_count);
+        object.set("totals", event_latency_sample_to_js(record.totals));
+        object.set("histogram", histogram);
+        object.set("recent", recent);
+        records.set(get_interned_name(entry.first), object);
+    }
+    return records;
+}
+
+EMSCRIPTEN_BINDINGS(event_latency)
+{
+    emscripten::function(
+        "enable_event_latency_tracking", &enable_event_latency_tracking);
+    emscripten::function(
+        "reset_event_latency_records", &reset_event_latency_records);
+    emscripten::function("get_event_latency", &get_event_latency_for_js);
+};
+
+void
+set_element_property(
+    element_object& object, char const* name, emscripten::val value)
+{
+    int name_id = intern_name(name);
+
+    // Arbitrary values can't go through the command buffer, so make sure the
+    // element actually exists (and is up-to-date) on the JS side first.
+    flush_commands();
+
+    emscripten::val::module_property("domNodes")[object.js_id].set(
+        name, value);
+    // (This bypasses the encoders, so it has to be counted here.)
+    ++get_command_buffer().mutations.property_sets;
+
+    // Record it in the element's 'domRaws' set (as the interpreter does for
+    // typed properties) so that it's cleared if the element is recycled.
+    EM_ASM_(
+        {
+            var element = Module['domNodes'][$0];
+            var raws = element['domRaws'];
+            if (!raws)
+                raws = element['domRaws'] = new Set();
+            raws.add($1);
+        },
+        object.js_id,
+        name_id);
+}
+
+emscripten::val
+get_element_property(element_object& object, char const* name)
+{
+    flush_commands();
+    return emscripten::val::module_property("domNodes")[object.js_id][name];
+}
+
+node_pool_stats
+get_node_pool_stats()
+{
+    flush_commands();
+    emscripten::val stats
+        = emscripten::val::module_property("domNodePoolStats");
+    node_pool_stats result;
+    result.hits = std::uint64_t(stats["hits"].as<double>());
+    result.misses = std::uint64_t(stats["misses"].as<double>());
+    result.size = std::uint64_t(stats["size"].as<double>());
+    return result;
+}
+
+void
+reset_node_pool_stats()
+{
+    flush_commands();
+    EM_ASM({
+        var stats = Module['domNodePoolStats'];
+        stats['hits'] = 0;
+        stats['misses'] = 0;
+    });
+}
+
+static void
+refresh_for_emscripten(void* system)
+{
+    refresh_system(*reinterpret_cast<alia::system*>(system));
+}
+
+struct dom_external_interface : frame_scheduled_external_interface
+{
+    dom_external_interface(alia::system& owner)
+        : frame_scheduled_external_interface(owner)
+    {
+    }
+
+    ~dom_external_interface()
+    {
+        if (timeout_armed)
+            emscripten_clear_timeout(timeout_id);
+    }
+
+    void
+    schedule_unaligned_refresh()
+    {
+        emscripten_async_call(refresh_for_emscripten, &this->owner, -1);
+    }
+
+    // Timers go through the system's internal scheduler, and there's only
+    // ever one JS timeout outstanding, armed for the earliest deadline.
+
+    void
+    schedule_timer_event(
+        external_component_id component, millisecond_count time)
+    {
+        schedule_system_timer_event(this->owner, component, time);
+        arm_timeout();
+    }
+
+    void
+    arm_timeout()
+    {
+        if (!has_scheduled_events(this->owner.scheduler))
+            return;
+        auto now = this->get_tick_count();
+        auto deadline
+            = now + get_time_until_next_event(this->owner.scheduler, now);
+        // If the current timeout will fire soon enough, leave it alone.
+        if (timeout_armed)
+        {
+            if (int(deadline - timeout_deadline) >= 0)
+                return;
+            emscripten_clear_timeout(timeout_id);
+        }
+        timeout_id = emscripten_set_timeout(
+            handle_timeout, double(deadline - now), this);
+        timeout_deadline = deadline;
+        timeout_armed = true;
+    }
+
+    static void
+    handle_timeout(void* user_data)
+    {
+        auto& self = *reinterpret_cast<dom_external_interface*>(user_data);
+        self.timeout_armed = false;
+        issue_due_timer_events(self.owner, self.get_tick_count());
+        self.arm_timeout();
+    }
+
+    bool timeout_armed = false;
+    int timeout_id = 0;
+    millisecond_count timeout_deadline = 0;
+};
+
+static void
+handle_host_timeout(void* user_data)
+{
+    auto& host = *reinterpret_cast<multi_root_host*>(user_data);
+    host.issue_timer_events(host.get_tick_count());
+}
+
+void
+set_host_timeout(multi_root_host& host, millisecond_count delay)
+{
+    host.timeout_id
+        = emscripten_set_timeout(handle_host_timeout, double(delay), &host);
+}
+
+void
+clear_host_timeout(multi_root_host& host)
+{
+    emscripten_clear_timeout(host.timeout_id);
+}
+
+// This drives the frame scheduler with requestAnimationFrame.
+struct animation_frame_clock : frame_clock
+{
+    double
+    now()
+    {
+        return emscripten_get_now();
+    }
+
+    void
+    request_frame()
+    {
+        emscripten_request_animation_frame(run_frame, nullptr);
+    }
+
+    static EM_BOOL
+    run_frame(double time, void* user_data)
+    {
+        run_scheduled_frame();
+        return EM_FALSE;
+    }
+};
+
+static emscripten::val
+get_frame_scheduler_stats_for_js()
+{
+    auto const& stats = get_frame_scheduler_stats();
+    emscripten::val object = emscripten::val::object();
+    object.set("requests", double(stats.requests));
+    object.set("merged", double(stats.merged));
+    object.set("frames", double(stats.frames));
+    object.set("refreshes", double(stats.refreshes));
+    object.set("deferred", double(stats.deferred));
+    object.set("lastFrameTime", stats.last_frame_time);
+    object.set("maxFrameTime", stats.max_frame_time);
+    return object;
+}
+
+static emscripten::val
+get_last_refresh_mutations_for_js()
+{
+    auto const& counts = get_last_refresh_mutations();
+    emscripten::val object = emscripten::val::object();
+    object.set("createdElements", double(counts.created_elements));
+    object.set("createdTextNodes", double(counts.created_text_nodes));
+    object.set("insertions", double(counts.insertions));
+    object.set("removals", double(counts.removals));
+    object.set("attributeSets", double(counts.attribute_sets));
+    object.set("attributeRemovals", double(counts.attribute_removals));
+    object.set("propertySets", double(counts.property_sets));
+    object.set("propertyRemovals", double(counts.property_removals));
+    object.set("nodeValueSets", double(counts.node_value_sets));
+    object.set("styleChanges", double(counts.style_changes));
+    object.set("classChanges", double(counts.class_changes));
+    object.set("stringBytes", double(counts.string_bytes));
+    return object;
+}
+
+EMSCRIPTEN_BINDINGS(mutation_counts)
+{
+    emscripten::function(
+        "get_last_refresh_mutations", &get_last_refresh_mutations_for_js);
+};
+
+static void
+enable_node_pooling_for_js(int capacity)
+{
+    enable_node_pooling(capacity);
+    flush_commands();
+}
+
+EMSCRIPTEN_BINDINGS(node_pool)
+{
+    emscripten::function("enable_node_pooling", &enable_node_pooling_for_js);
+    emscripten::function("reset_node_pool_stats", &reset_node_pool_stats);
+};
+
+EMSCRIPTEN_BINDINGS(frame_scheduler)
+{
+    emscripten::function("enable_frame_scheduling", &enable_frame_scheduling);
+    emscripten::function("set_frame_budget", &set_frame_budget);
+    emscripten::function(
+        "get_frame_scheduler_stats", &get_frame_scheduler_stats_for_js);
+    emscripten::function(
+        "reset_frame_scheduler_stats", &reset_frame_scheduler_stats);
+};
+
+static void
+execute_commands(std::uint32_t const* words, std::size_t size)
+{
+    EM_ASM_({ Module['executeDomCommands']($0, $1); }, words, size);
+}
+
+// Install the JS side of the command buffer. This is an interpreter loop that
+// decodes the commands directly out of wasm memory and applies them.
+// (See command_buffer.hpp for a description of the encoding.)
+static void
+install_command_interpreter()
+{
+    EM_ASM({
+        var nodes = [null];
+        Module['domNodes'] = nodes;
+        var names = [];
+        Module['domNames'] = names;
+        // Install a listener on :root that delegates all events of the given
+        // type back to wasm. This listens in the capture phase so that it also
+        // sees events that don't bubble (focus, blur, etc.).
+        var delegateEvents = function(root, type)
+        {
+            root.addEventListener(names[type], function(e)
+            {
+                // Collect the path first (along with the IDs that the nodes
+                // have now), since the handlers can change the DOM.
+                var path = [];
+                for (var node = e.target; node && node !== root;
+                     node = node.parentNode)
+                {
+                    if (node['domId'])
+                        path.push([node, node['domId']]);
+                    if (!e.bubbles)
+                        break;
+                }
+                for (var j = 0; j < path.length; ++j)
+                {
+                    // Skip nodes that have been removed since the event
+                    // started. (A removed element can be taken from the pool
+                    // and reused under a different ID, so it's not enough to
+                    // check that it still has one.)
+                    var id = path[j][1];
+                    if (path[j][0]['domId'] !== id)
+                        continue;
+                    Module.dispatch_delegated_event(id, type, e);
+                    if (e.cancelBubble)
+                        break;
+                }
+            }, true);
+        };
+        // the root elements of the templates, by template ID
+        var templates = [];
+        // hydration state (See command_buffer.hpp.)
+        // While hydrating, created nodes are left pending until they're
+        // inserted. For each parent that's being hydrated, :cursors holds the
+        // next existing child to adopt.
+        var hydrating = false;
+        var pending = {};
+        var cursors = new Map();
+        // For each element that's been adopted, :adopted holds the set of
+        // attributes that have been set on it since. Any others came from the
+        // existing content and are removed at the end.
+        var adopted = new Map();
+        var keepAttribute = function(node, name)
+        {
+            var kept = adopted.get(node);
+            if (kept)
+                kept.add(name);
+        };
+        // Skip (and drop) the comments that separate adjacent text nodes in
+        // server-rendered content.
+        var skipSeparators = function(parent, node)
+        {
+            while (node && node.nodeType == 8)
+            {
+                var next = node.nextSibling;
+                parent.removeChild(node);
+                node = next;
+            }
+            return node;
+        };
+        var insertPending = function(parent, id, before)
+        {
+            var info = pending[id];
+            delete pending[id];
+            var next = before ? nodes[before] : null;
+            if (!before && cursors.has(parent))
+            {
+                next = skipSeparators(parent, cursors.get(parent));
+                if (next
+                    && (info.tag ? next.nodeType == 1
+                                       && next.tagName.toLowerCase() == info.tag
+                                 : next.nodeType == 3))
+                {
+                    // Adopt the existing node.
+                    cursors.set(parent, next.nextSibling);
+                    if (info.tag)
+                    {
+                        // A template instance keeps the template's
+                        // attributes.
+                        var kept = new Set();
+                        if (info.template !== undefined)
+                        {
+                            var source = templates[info.template];
+                            for (var j = 0; j < source.attributes.length; ++j)
+                                kept.add(source.attributes[j].name);
+                        }
+                        adopted.set(next, kept);
+                        next['domId'] = id;
+                        // (Template instances have no further content to
+                        // adopt.)
+                        if (info.template === undefined)
+                            cursors.set(next, next.firstChild);
+                    }
+                    nodes[id] = next;
+                    return;
+                }
+                cursors.set(parent, next);
+            }
+            var node;
+            if (info.template !== undefined)
+            {
+                node = templates[info.template].cloneNode(true);
+                node['domId'] = id;
+            }
+            else if (info.tag)
+            {
+                node = document.createElement(info.tag);
+                node['domId'] = id;
+            }
+            else
+            {
+                node = document.createTextNode(info.text);
+            }
+            nodes[id] = node;
+            parent.insertBefore(node, next);
+        };
+        // node pool (See command_buffer.hpp.)
+        // Pooled elements are kept in arrays indexed by tag name ID, so each
+        // element records the ID of its tag as 'domTag'.
+        var poolCapacity = 0;
+        var pools = [];
+        var poolStats = {};
+        poolStats['hits'] = 0;
+        poolStats['misses'] = 0;
+        poolStats['size'] = 0;
+        Module['domNodePoolStats'] = poolStats;
+        // Reset a property that was set directly on a node. Properties that
+        // the DOM defines (e.g., 'value' or 'checked') can't be deleted, so
+        // they're given the values that a fresh element of the same type has.
+        // (Assigning undefined would turn 'value' into "undefined".)
+        var pristineElements = {};
+        var resetProperty = function(node, name)
+        {
+            var property = names[name];
+            var pristine = null;
+            if (node.nodeType == 1)
+            {
+                var tag = node.tagName;
+                pristine = pristineElements[tag];
+                if (!pristine)
+                {
+                    pristine = pristineElements[tag]
+                        = document.createElement(tag);
+                }
+            }
+            if (pristine && property in pristine)
+                node[property] = pristine[property];
+            else
+                delete node[property];
+        };
+        var releaseElement = function(element)
+        {
+            var tag = element['domTag'];
+            if (!tag || element['domDelegates'])
+                return;
+            var pool = pools[tag];
+            if (!pool)
+                pool = pools[tag] = [];
+            if (pool.length >= poolCapacity)
+                return;
+            // Strip it back to a freshly created state.
+            var attributes = element.attributes;
+            while (attributes.length)
+                element.removeAttribute(attributes[0].name);
+            var raws = element['domRaws'];
+            if (raws)
+            {
+                raws.forEach(function(name) {
+                    resetProperty(element, name);
+                });
+                delete element['domRaws'];
+            }
+            var events = element['asmDomEvents'];
+            if (events)
+            {
+                for (var type in events)
+                    element.removeEventListener(type, events[type], false);
+                delete element['asmDomEvents'];
+            }
+            element.textContent = '';
+            pool.push(element);
+            ++poolStats['size'];
+        };
+        // Set a property directly, recording its name ID in the node's
+        // 'domRaws' set.
+        var setProperty = function(node, name, value)
+        {
+            node[names[name]] = value;
+            var raws = node['domRaws'];
+            if (!raws)
+                raws = node['domRaws'] = new Set();
+            raws.add(name);
+        };
+        // scratch space for reassembling doubles from pairs of words
+        var doubleWords = new Uint32Array(2);
+        var doubleValue = new Float64Array(doubleWords.buffer);
+        // Format a number for SET_NODE_NUMBER. (See command_buffer.hpp.)
+        var formatNumber = function(value, format)
+        {
+            var precision = format & 0xff;
+            var text
+                = precision == 0xff ? String(value) : value.toFixed(precision);
+            if (format & 0x100)
+            {
+                var end = text.indexOf('.');
+                if (end < 0)
+                    end = text.length;
+                var start = text.charAt(0) == '-' ? 1 : 0;
+                for (var j = end; j > start + 3; j -= 3)
+                    text = text.slice(0, j - 3) + ',' + text.slice(j - 3);
+            }
+            return text;
+        };
+        Module['executeDomCommands'] = function(ptr, size)
+        {
+            var words = HEAPU32;
+            var i = ptr >> 2;
+            var end = i + size;
+            var readString = function()
+            {
+                var length = words[i];
+                var text = Module['UTF8ToString']((i + 1) << 2);
+                i += 1 + ((length + 4) >> 2);
+                return text;
+            };
+            while (i < end)
+            {
+                var code = words[i];
+                var id = words[i + 1];
+                i += 2;
+                switch (code)
+                {
+                    case 1: // CREATE_ELEMENT
+                        if (hydrating)
+                        {
+                            pending[id] = {tag : names[words[i++]]};
+                            break;
+                        }
+                        var tag = words[i++];
+                        var pool = poolCapacity ? pools[tag] : null;
+                        var element;
+                        if (pool && pool.length)
+                        {
+                            element = pool.pop();
+                            ++poolStats['hits'];
+                            --poolStats['size'];
+                        }
+                        else
+                        {
+                            element = document.createElement(names[tag]);
+                            element['domTag'] = tag;
+                            if (poolCapacity)
+                                ++poolStats['misses'];
+                        }
+                        // This is how delegated events find their targets.
+                        element['domId'] = id;
+                        nodes[id] = element;
+                        break;
+                    case 2: // CREATE_TEXT_NODE
+                        if (hydrating)
+                        {
+                            pending[id] = {text : readString()};
+                            break;
+                        }
+                        nodes[id] = document.createTextNode(readString());
+                        break;
+                    case 3: // INSERT_BEFORE
+                        var child = words[i];
+                        var before = words[i + 1];
+                        i += 2;
+                        if (hydrating && pending[child])
+                        {
+                            insertPending(nodes[id], child, before);
+                            break;
+                        }
+                        nodes[id].insertBefore(
+                            nodes[child], before ? nodes[before] : null);
+                        break;
+                    case 4: // REMOVE_CHILD
+                    case 27: // RELEASE_NODE
+                        var node = nodes[id];
+                        var parent = node.parentNode;
+                        if (parent && code == 4)
+                            parent.removeChild(node);
+                        node['domId'] = 0;
+                        nodes[id] = null;
+                        if (poolCapacity)
+                            releaseElement(node);
+                        break;
+                    case 5: // SET_ATTRIBUTE
+                        var name = names[words[i++]];
+                        if (hydrating)
+                            keepAttribute(nodes[id], name);
+                        nodes[id].setAttribute(name, readString());
+                        break;
+                    case 6: // REMOVE_ATTRIBUTE
+                        nodes[id].removeAttribute(names[words[i++]]);
+                        break;
+                    case 7: // SET_NODE_VALUE
+                        nodes[id].nodeValue = readString();
+                        break;
+                    case 8: // DEFINE_NAME
+                        names[id] = readString();
+                        break;
+                    case 9: // DELEGATE_EVENTS
+                        nodes[id]['domDelegates'] = true;
+                        delegateEvents(nodes[id], words[i++]);
+                        break;
+                    case 10: // BEGIN_HYDRATION
+                        hydrating = true;
+                        cursors.set(nodes[id], nodes[id].firstChild);
+                        break;
+                    case 11: // END_HYDRATION
+                        // Remove any existing content that wasn't adopted.
+                        cursors.forEach(function(next, parent) {
+                            while (next)
+                            {
+                                var after = next.nextSibling;
+                                parent.removeChild(next);
+                                next = after;
+                            }
+                        });
+                        cursors = new Map();
+                        // Remove any existing attributes that the adopted
+                        // elements didn't set.
+                        adopted.forEach(function(kept, element) {
+                            var attributes = element.attributes;
+                            for (var j = attributes.length; j-- > 0;)
+                            {
+                                var name = attributes[j].name;
+                                if (!kept.has(name))
+                                    element.removeAttribute(name);
+                            }
+                        });
+                        adopted = new Map();
+                        pending = {};
+                        hydrating = false;
+                        break;
+                    case 12: // SET_STYLE
+                        if (hydrating)
+                            keepAttribute(nodes[id], 'style');
+                        var name = names[words[i++]];
+                        nodes[id].style.setProperty(name, readString());
+                        break;
+                    case 13: // SET_STYLE_NUMBER
+                        if (hydrating)
+                            keepAttribute(nodes[id], 'style');
+                        var name = names[words[i]];
+                        var unit = names[words[i + 1]];
+                        doubleWords[0] = words[i + 2];
+                        doubleWords[1] = words[i + 3];
+                        i += 4;
+                        nodes[id].style.setProperty(
+                            name, doubleValue[0] + unit);
+                        break;
+                    case 14: // SET_STYLE_COLOR
+                        if (hydrating)
+                            keepAttribute(nodes[id], 'style');
+                        var name = names[words[i]];
+                        var rgb = words[i + 1];
+                        i += 2;
+                        nodes[id].style.setProperty(
+                            name,
+                            'rgb(' + (rgb >> 16) + ', ' + ((rgb >> 8) & 0xff)
+                                + ', ' + (rgb & 0xff) + ')');
+                        break;
+                    case 15: // REMOVE_STYLE
+                        nodes[id].style.removeProperty(names[words[i++]]);
+                        break;
+                    case 16: // ADD_CLASS
+                        if (hydrating)
+                            keepAttribute(nodes[id], 'class');
+                        nodes[id].classList.add(names[words[i++]]);
+                        break;
+                    case 17: // REMOVE_CLASS
+                        nodes[id].classList.remove(names[words[i++]]);
+                        break;
+                    case 18: // SET_NODE_NUMBER
+                        doubleWords[0] = words[i + 1];
+                        doubleWords[1] = words[i + 2];
+                        nodes[id].nodeValue
+                            = formatNumber(doubleValue[0], words[i]);
+                        i += 3;
+                        break;
+                    case 19: // CONFIGURE_NODE_POOL
+                        poolCapacity = words[i++];
+                        pools = [];
+                        poolStats['size'] = 0;
+                        break;
+                    case 20: // SET_STRING_PROPERTY
+                        var name = words[i++];
+                        setProperty(nodes[id], name, readString());
+                        break;
+                    case 21: // SET_NUMBER_PROPERTY
+                        doubleWords[0] = words[i + 1];
+                        doubleWords[1] = words[i + 2];
+                        setProperty(nodes[id], words[i], doubleValue[0]);
+                        i += 3;
+                        break;
+                    case 22: // SET_BOOLEAN_PROPERTY
+                        setProperty(nodes[id], words[i], words[i + 1] != 0);
+                        i += 2;
+                        break;
+                    case 23: // REMOVE_PROPERTY
+                        var node = nodes[id];
+                        var name = words[i++];
+                        resetProperty(node, name);
+                        if (node['domRaws'])
+                            node['domRaws'].delete(name);
+                        break;
+                    case 24: // DETACH_NODE
+                        var node = nodes[id];
+                        if (node.parentNode)
+                            node.parentNode.removeChild(node);
+                        break;
+                    case 25: // DEFINE_TEMPLATE
+                        var template = document.createElement('template');
+                        template.innerHTML = readString();
+                        templates[id] = template.content.firstChild;
+                        break;
+                    case 26: // CLONE_TEMPLATE
+                        var template = words[i++];
+                        if (hydrating)
+                        {
+                            var root = templates[template];
+                            var info = {};
+                            info.tag = root.tagName.toLowerCase();
+                            info.template = template;
+                            pending[id] = info;
+                            break;
+                        }
+                        var element = templates[template].cloneNode(true);
+                        element['domId'] = id;
+                        nodes[id] = element;
+                        break;
+                    default:
+                        throw new Error('invalid DOM command: ' + code);
+                }
+            }
+        };
+    });
+    get_command_buffer().executor = execute_commands;
+}
+
+// Do the one-time setup of the JS side.
+static void
+initialize_backend()
+{
+    // Initialize asm-dom (once).
+    static bool asmdom_initialized = false;
+    if (!asmdom_initialized)
+    {
+        asmdom::Config config = asmdom::Config();
+        config.unsafePatch = true;
+        config.clearMemory = true;
+        asmdom::init(config);
+        install_command_interpreter();
+        static animation_frame_clock clock;
+        set_frame_clock(&clock);
+        asmdom_initialized = true;
+    }
+}
+
+void
+initialize(
+    dom::system& dom_system,
+    alia::system& alia_system,
+    std::string const& dom_node_id,
+    std::function<void(dom::context)> controller,
+    bool hydrate)
+{
+    initialize_backend();
+
+    // Initialize the alia::system and hook it up to the dom::system.
+    initialize_system(
+        alia_system,
+        std::ref(dom_system),
+        new dom_external_interface(alia_system));
+    dom_system.controller = std::move(controller);
+
+    attach_system(dom_system, alia_system, dom_node_id, hydrate);
+}
+
+void
+attach_system(
+    dom::system& dom_system,
+    alia::system& alia_system,
+    std::string const& dom_node_id,
+    bool hydrate)
+{
+    initialize_backend();
+
+    emscripten::val document = emscripten::val::global("document");
+    emscripten::val placeholder
+        = document.call<emscripten::val>("getElementById", dom_node_id);
+    if (placeholder.isNull())
+    {
+        auto msg = dom_node_id + " not found in document";
+        EM_ASM_({ console.error(Module['UTF8ToString']($0)); }, msg.c_str());
+        throw exception(msg);
+    }
+
+    if (hydrate)
+    {
+        // Adopt the placeholder (and its contents).
+        int root = allocate_node_id();
+        dom_system.root_node.object.js_id = root;
+        emscripten::val::module_property("domNodes").set(root, placeholder);
+        command_buffer& buffer = get_command_buffer();
+        encode_begin_hydration(buffer, root);
+        refresh_system(alia_system);
+        encode_end_hydration(buffer, root);
+        flush_commands(buffer);
+        return;
+    }
+
+    // Replace the requested node in the DOM with our virtual DOM.
+    // For now, just create a div to hold all our content.
+    emscripten::val root = document.call<emscripten::val>(
+        "createElement", emscripten::val("div"));
+    placeholder["parentNode"].call<emscripten::val>(
+        "replaceChild", root, placeholder);
+    dom_system.root_node.object.js_id = allocate_node_id();
+    emscripten::val::module_property("domNodes").set(
+        dom_system.root_node.object.js_id, root);
+
+    // Update the virtual DOM.
+    refresh_system(alia_system);
+    flush_commands();
+}
+
+} // namespace dom
@@ -0,0 +1,220 @@
+#include "dom.hpp"
+#include "multi_root_host.hpp"
+
+#include <sstream>
+
+// This file implements the parts of the DOM layer that are specific to the
+// headless (native) backend.
+
+namespace dom {
+
+static void
+execute_commands(std::uint32_t const* words, std::size_t size)
+{
+    decode_commands(words, size, get_headless_document());
+}
+
+void
+set_element_property(element_object& object, char const* name, js_value value)
+{
+    flush_commands();
+    get_headless_document().get_node(object.js_id)->properties.set(
+        name, value);
+}
+
+js_value
+get_element_property(element_object& object, char const* name)
+{
+    flush_commands();
+    return get_headless_document().get_node(object.js_id)->properties[name];
+}
+
+node_pool_stats
+get_node_pool_stats()
+{
+    flush_commands();
+    return get_headless_document().pool_stats();
+}
+
+void
+reset_node_pool_stats()
+{
+    flush_commands();
+    get_headless_document().reset_pool_stats();
+}
+
+// There are no real timers here. Whoever is driving the document checks the
+// host's timeout_deadline instead.
+
+void
+set_host_timeout(multi_root_host& host, millisecond_count delay)
+{
+}
+
+void
+clear_host_timeout(multi_root_host& host)
+{
+}
+
+static void
+install_headless_backend()
+{
+    get_command_buffer().executor = execute_commands;
+    get_headless_document().event_delegate
+        = [](int node, std::string const& type, headless_value event) {
+              dispatch_delegated_event(node, intern_name(type.c_str()), event);
+          };
+}
+
+void
+initialize(
+    dom::system& dom_system,
+    alia::system& alia_system,
+    std::string const& dom_node_id,
+    std::function<void(dom::context)> controller,
+    bool hydrate)
+{
+    // Initialize the alia::system and hook it up to the dom::system.
+    // (Other than frame scheduling, which is driven by whatever frame_clock the
+    // host installs, the default external behavior is fine here. Whoever is
+    // driving the headless document is responsible for checking
+    // system_needs_refresh() and processing timer events.)
+    initialize_system(
+        alia_system,
+        std::ref(dom_system),
+        new frame_scheduled_external_interface(alia_system));
+    dom_system.controller = std::move(controller);
+
+    attach_system(dom_system, alia_system, dom_node_id, hydrate);
+}
+
+void
+attach_system(
+    dom::system& dom_system,
+    alia::system& alia_system,
+    std::string const& dom_node_id,
+    bool hydrate)
+{
+    install_headless_backend();
+
+    headless_document& document = get_headless_document();
+    command_buffer& buffer = get_command_buffer();
+    headless_node* placeholder = document.get_element_by_id(dom_node_id);
+    if (!placeholder)
+        throw exception(dom_node_id + " not found in document");
+
+    if (hydrate)
+    {
+        // Adopt the placeholder (and its contents).
+        dom_system.root_node.object.js_id = placeholder->id;
+        encode_begin_hydration(buffer, placeholder->id);
+        refresh_system(alia_system);
+        encode_end_hydration(buffer, placeholder->id);
+        flush_commands(buffer);
+        return;
+    }
+
+    // Replace the placeholder with our root.
+    int root = allocate_node_id();
+    encode_create_element(buffer, root, intern_name("div"));
+    encode_insert_before(
+        buffer, placeholder->parent->id, root, placeholder->id);
+    encode_remove_child(buffer, placeholder->id);
+    flush_commands(buffer);
+    dom_system.root_node.object.js_id = root;
+
+    // Update the virtual DOM.
+    refresh_system(alia_system);
+    flush_commands(buffer);
+}
+
+void
+mount_placeholder(
+    headless_document& document, command_buffer& buffer, char const* id)
+{
+    int placeholder = allocate_node_id();
+    encode_create_element(buffer, placeholder, intern_name("div"));
+    encode_set_attribute(buffer, placeholder, intern_name("id"), id);
+    encode_insert_before(buffer, document.body().id, placeholder, 0);
+    flush_commands(buffer);
+}
+
+// Create (and insert into :parent) the equivalent of each child of :source.
+static void
+encode_parsed_children(
+    command_buffer& buffer, headless_node const& source, int parent)
+{
+    for (headless_node const* child = source.first_child; child;
+         child = child->next_sibling)
+    {
+        int id = allocate_node_id();
+        if (child->is_text())
+        {
+            encode_create_text_node(buffer, id, child->text.c_str());
+        }
+        else
+        {
+            encode_create_element(buffer, id, intern_name(child->tag.c_str()));
+            for (auto const& attribute : child->attributes)
+            {
+                encode_set_attribute(
+                    buffer,
+                    id,
+                    intern_name(attribute.first.c_str()),
+                    attribute.second.c_str());
+            }
+        }
+        encode_insert_before(buffer, parent, id, 0);
+        encode_parsed_children(buffer, *child, id);
+    }
+}
+
+void
+mount_rendered_placeholder(
+    headless_document& document,
+    command_buffer& buffer,
+    char const* id,
+    std::string const& html)
+{
+    headless_node parsed;
+    parse_html(("<div>" + html + "</div>").c_str(), parsed);
+
+    int placeholder = allocate_node_id();
+    encode_create_element(buffer, placeholder, intern_name("div"));
+    encode_set_attribute(buffer, placeholder, intern_name("id"), id);
+    encode_parsed_children(buffer, parsed, placeholder);
+    encode_insert_before(buffer, document.body().id, placeholder, 0);
+    flush_commands(buffer);
+}
+
+std::string
+render_to_html(std::function<void(dom::context)> controller)
+{
+    install_headless_backend();
+    command_buffer& buffer = get_command_buffer();
+
+    std::ostringstream html;
+    {
+        // Note that the alia::system has to be destroyed first, since the
+        // content in it refers to the root node.
+        dom::system dom_system;
+        alia::system alia_system;
+        initialize_system(alia_system, std::ref(dom_system));
+        dom_system.controller = std::move(controller);
+
+        // The root is created on its own (outside the body).
+        int root = allocate_node_id();
+        encode_create_element(buffer, root, intern_name("div"));
+        dom_system.root_node.object.js_id = root;
+
+        refresh_system(alia_system);
+
+        write_inner_html(html, *get_headless_document().get_node(root));
+    }
+    // Clean up the nodes that were removed along with the systems.
+    flush_commands(buffer);
+
+    return html.str();
+}
+
+} // namespace dom
@@ -0,0 +1,110 @@
+#include "event_latency.hpp"
+
+#include "command_buffer.hpp"
+
+#include <chrono>
+
+namespace dom {
+
+namespace {
+
+struct latency_tracking_state
+{
+    bool enabled = false;
+    double total_flush_time = 0;
+    std::unordered_map<int, event_latency_record> records;
+};
+
+latency_tracking_state&
+get_tracking_state()
+{
+    static latency_tracking_state the_state;
+    return the_state;
+}
+
+} // namespace
+
+void
+enable_event_latency_tracking(bool enabled)
+{
+    get_tracking_state().enabled = enabled;
+}
+
+bool
+is_event_latency_tracking_enabled()
+{
+    return get_tracking_state().enabled;
+}
+
+std::unordered_map<int, event_latency_record> const&
+get_event_latency_records()
+{
+    return get_tracking_state().records;
+}
+
+event_latency_record const*
+get_event_latency_record(char const* event_type)
+{
+    // (If the name isn't known, no event of this type has been recorded, and
+    // there's no need to intern it.)
+    int name = find_interned_name(event_type);
+    if (name < 0)
+        return nullptr;
+    auto const& records = get_tracking_state().records;
+    auto i = records.find(name);
+    return i != records.end() ? &i->second : nullptr;
+}
+
+void
+reset_event_latency_records()
+{
+    get_tracking_state().records.clear();
+}
+
+double
+get_latency_timestamp()
+{
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void
+add_flush_time(double microseconds)
+{
+    get_tracking_state().total_flush_time += microseconds;
+}
+
+double
+get_total_flush_time()
+{
+    return get_tracking_state().total_flush_time;
+}
+
+static std::size_t
+get_histogram_bucket(double microseconds)
+{
+    std::size_t bucket = 0;
+    while (bucket + 1 < event_latency_record::bucket_count
+           && microseconds >= double(1u << bucket))
+    {
+        ++bucket;
+    }
+    return bucket;
+}
+
+void
+record_event_latency(int event_type, event_latency_sample const& sample)
+{
+    event_latency_record& record = get_tracking_state().records[event_type];
+    ++record.histogram[get_histogram_bucket(sample.total())];
+    record.recent
+        [record.sample_count % event_latency_record::recent_sample_count]
+        = sample;
+    ++record.sample_count;
+    record.totals.dispatch += sample.dispatch;
+    record.totals.traversal += sample.traversal;
+    record.totals.flush += sample.flush;
+}
+
+} // namespace dom
@@ -0,0 +1,103 @@
+#ifndef EVENT_LATENCY_HPP
+#define EVENT_LATENCY_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+// This file provides optional instrumentation of DOM event handling latency.
+//
+// It's off by default, in which case the only cost is a check of a flag for
+// each event. When it's enabled, every delegated DOM event is timed and the
+// time is split into three phases:
+//
+// - dispatch: routing the event through the controller (i.e., running the
+//   actual handler)
+// - traversal: the refresh traversal that follows the event
+// - flush: executing the DOM commands generated by both of the above
+//
+// The results are recorded per event type in fixed-size records, so tracking
+// doesn't allocate per event.
+//
+// Note that when frame scheduling is enabled (see frame_scheduler.hpp), the
+// traversal is deferred to the next frame, so it isn't attributed to the
+// event.
+
+namespace dom {
+
+// the timing of a single event (in microseconds)
+struct event_latency_sample
+{
+    double dispatch = 0;
+    double traversal = 0;
+    double flush = 0;
+
+    double
+    total() const
+    {
+        return dispatch + traversal + flush;
+    }
+};
+
+struct event_latency_record
+{
+    // a histogram of total event latency - Bucket 0 counts events that took
+    // less than 1 microsecond. Bucket i counts events that took at least
+    // 2^(i-1) microseconds but less than 2^i. The last bucket also counts
+    // anything longer.
+    static constexpr std::size_t bucket_count = 20;
+    std::array<std::uint32_t, bucket_count> histogram{};
+
+    // the most recent samples (a ring buffer)
+    static constexpr std::size_t recent_sample_count = 64;
+    std::array<event_latency_sample, recent_sample_count> recent;
+
+    // the total number of samples recorded
+    // (The most recent sample is at recent[(sample_count - 1) %
+    // recent_sample_count].)
+    std::uint32_t sample_count = 0;
+
+    // the sum of all samples recorded
+    event_latency_sample totals;
+};
+
+// Enable/disable latency tracking.
+void
+enable_event_latency_tracking(bool enabled);
+
+bool
+is_event_latency_tracking_enabled();
+
+// Get the records collected so far, indexed by event type (an interned name).
+std::unordered_map<int, event_latency_record> const&
+get_event_latency_records();
+
+// Get the record for a particular event type (or null if there isn't one).
+event_latency_record const*
+get_event_latency_record(char const* event_type);
+
+// Clear all records.
+void
+reset_event_latency_records();
+
+// The following are used by the DOM layer to do the actual recording...
+
+// a timestamp in microseconds
+double
+get_latency_timestamp();
+
+// Add to the total time spent flushing the command buffer.
+void
+add_flush_time(double microseconds);
+
+// the total time spent flushing the command buffer (while tracking)
+double
+get_total_flush_time();
+
+void
+record_event_latency(int event_type, event_latency_sample const& sample);
+
+} // namespace dom
+
+#endif
@@ -0,0 +1,194 @@
+#include "frame_scheduler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace dom {
+
+namespace {
+
+struct frame_scheduler_state
+{
+    frame_clock* clock = nullptr;
+    bool enabled = false;
+    double budget = 8;
+    bool frame_requested = false;
+    // the systems that need to be refreshed, in the order in which they were
+    // first requested
+    std::vector<alia::system*> dirty;
+    std::vector<std::function<void()>> tasks;
+    frame_scheduler_stats stats;
+};
+
+frame_scheduler_state&
+get_scheduler_state()
+{
+    static frame_scheduler_state the_state;
+    return the_state;
+}
+
+void
+request_frame(frame_scheduler_state& state)
+{
+    if (!state.frame_requested)
+    {
+        state.frame_requested = true;
+        state.clock->request_frame();
+    }
+}
+
+} // namespace
+
+void
+manual_frame_clock::advance(double milliseconds)
+{
+    time += milliseconds;
+    if (frame_requested)
+    {
+        frame_requested = false;
+        run_scheduled_frame();
+    }
+}
+
+void
+set_frame_clock(frame_clock* clock)
+{
+    auto& state = get_scheduler_state();
+    state.clock = clock;
+    state.frame_requested = false;
+    if (clock && !(state.dirty.empty() && state.tasks.empty()))
+        request_frame(state);
+}
+
+bool
+has_frame_clock()
+{
+    return get_scheduler_state().clock != nullptr;
+}
+
+void
+enable_frame_scheduling(bool enabled)
+{
+    get_scheduler_state().enabled = enabled;
+    // Don't leave anything stranded.
+    if (!enabled)
+        run_scheduled_frame();
+}
+
+bool
+is_frame_scheduling_enabled()
+{
+    auto const& state = get_scheduler_state();
+    return state.enabled && state.clock;
+}
+
+void
+set_frame_budget(double milliseconds)
+{
+    get_scheduler_state().budget = milliseconds;
+}
+
+frame_scheduler_stats const&
+get_frame_scheduler_stats()
+{
+    return get_scheduler_state().stats;
+}
+
+void
+reset_frame_scheduler_stats()
+{
+    get_scheduler_state().stats = frame_scheduler_stats();
+}
+
+void
+request_frame_refresh(alia::system& sys)
+{
+    auto& state = get_scheduler_state();
+    ++state.stats.requests;
+    sys.refresh_needed = true;
+    if (std::find(state.dirty.begin(), state.dirty.end(), &sys)
+        != state.dirty.end())
+    {
+        ++state.stats.merged;
+        return;
+    }
+    state.dirty.push_back(&sys);
+    request_frame(state);
+}
+
+void
+cancel_frame_refresh(alia::system& sys)
+{
+    auto& dirty = get_scheduler_state().dirty;
+    dirty.erase(std::remove(dirty.begin(), dirty.end(), &sys), dirty.end());
+}
+
+void
+schedule_frame_task(std::function<void()> task)
+{
+    auto& state = get_scheduler_state();
+    assert(state.clock);
+    state.tasks.push_back(std::move(task));
+    request_frame(state);
+}
+
+void
+run_scheduled_frame()
+{
+    auto& state = get_scheduler_state();
+    state.frame_requested = false;
+
+    // Tasks can schedule further tasks, which should wait for the next frame.
+    std::vector<std::function<void()>> tasks;
+    std::swap(tasks, state.tasks);
+    for (auto& task : tasks)
+        task();
+
+    if (state.dirty.empty())
+    {
+        if (!state.tasks.empty() && state.clock)
+            request_frame(state);
+        return;
+    }
+
+    // Refreshing can request further refreshes (e.g., for animations), and
+    // those belong to the next frame, so work from a copy.
+    std::vector<alia::system*> systems;
+    std::swap(systems, state.dirty);
+
+    double start = state.clock ? state.clock->now() : 0;
+    double elapsed = 0;
+    auto& stats = state.stats;
+    for (std::size_t i = 0; i != systems.size(); ++i)
+    {
+        if (i != 0 && state.clock && elapsed >= state.budget)
+        {
+            // Defer the rest (ahead of anything requested in the meantime).
+            stats.deferred += systems.size() - i;
+            for (std::size_t j = i; j != systems.size(); ++j)
+            {
+                state.dirty.erase(
+                    std::remove(
+                        state.dirty.begin(), state.dirty.end(), systems[j]),
+                    state.dirty.end());
+            }
+            state.dirty.insert(
+                state.dirty.begin(), systems.begin() + i, systems.end());
+            break;
+        }
+        alia::refresh_system(*systems[i]);
+        ++stats.refreshes;
+        if (state.clock)
+            elapsed = state.clock->now() - start;
+    }
+
+    ++stats.frames;
+    stats.last_frame_time = elapsed;
+    stats.max_frame_time = (std::max)(stats.max_frame_time, elapsed);
+
+    if (!(state.dirty.empty() && state.tasks.empty()) && state.clock)
+        request_frame(state);
+}
+
+} // namespace dom
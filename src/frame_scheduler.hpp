@@ -0,0 +1,171 @@
+#ifndef FRAME_SCHEDULER_HPP
+#define FRAME_SCHEDULER_HPP
+
+#include "alia.hpp"
+
+#include <cstdint>
+#include <functional>
+
+// This file provides an optional scheduler that aligns refreshes with
+// animation frames.
+//
+// Normally, a system is refreshed as soon as something changes, so several
+// events within one frame cause several full refreshes, even though only the
+// last one is ever visible. With frame scheduling enabled, refresh requests
+// just mark the system as dirty, and each dirty system is refreshed exactly
+// once at the start of the next frame.
+//
+// Frames (and time) come from a frame_clock. The backends install one that's
+// driven by requestAnimationFrame. Native code can drive the scheduler
+// deterministically with a manual_frame_clock.
+
+namespace dom {
+
+struct frame_clock
+{
+    virtual ~frame_clock()
+    {
+    }
+
+    // the current time, in milliseconds
+    virtual double
+    now() = 0;
+
+    // Arrange for run_scheduled_frame() to be called at the next frame.
+    virtual void
+    request_frame()
+        = 0;
+};
+
+// a clock whose time and frames are advanced explicitly
+struct manual_frame_clock : frame_clock
+{
+    double time = 0;
+    bool frame_requested = false;
+
+    double
+    now()
+    {
+        return time;
+    }
+
+    void
+    request_frame()
+    {
+        frame_requested = true;
+    }
+
+    // Advance the time and then run a frame (if one was requested).
+    void
+    advance(double milliseconds);
+};
+
+struct frame_scheduler_stats
+{
+    // the number of refreshes that were requested
+    std::uint64_t requests = 0;
+    // the number of requests that were merged into an already pending refresh
+    std::uint64_t merged = 0;
+    // the number of frames that were run
+    std::uint64_t frames = 0;
+    // the number of system refreshes that were performed
+    std::uint64_t refreshes = 0;
+    // the number of refreshes that were put off until a later frame because
+    // the frame was already over budget
+    std::uint64_t deferred = 0;
+    // the duration of the most recent frame and the longest frame so far
+    // (in milliseconds)
+    double last_frame_time = 0;
+    double max_frame_time = 0;
+};
+
+// Set the clock that drives the scheduler. (Frame scheduling is only active
+// when there's a clock.)
+void
+set_frame_clock(frame_clock* clock);
+
+bool
+has_frame_clock();
+
+// Enable/disable frame scheduling.
+void
+enable_frame_scheduling(bool enabled);
+
+bool
+is_frame_scheduling_enabled();
+
+// Set the time available for refreshes within each frame (in milliseconds).
+// Once it's used up, any remaining dirty systems are deferred to the next
+// frame. (At least one system is always refreshed per frame.)
+void
+set_frame_budget(double milliseconds);
+
+frame_scheduler_stats const&
+get_frame_scheduler_stats();
+
+void
+reset_frame_scheduler_stats();
+
+// Mark a system as needing a refresh on the next frame.
+void
+request_frame_refresh(alia::system& sys);
+
+// Remove a system from the scheduler. (This must be done before the system is
+// destroyed.)
+void
+cancel_frame_refresh(alia::system& sys);
+
+// Schedule a function to be called at the start of the next frame (before any
+// systems are refreshed). This works whether or not frame scheduling is
+// enabled, but it requires a clock.
+void
+schedule_frame_task(std::function<void()> task);
+
+// Run the frame tasks and refresh the dirty systems. This is what the clock
+// invokes at each frame.
+void
+run_scheduled_frame();
+
+// This is an external interface that routes refresh requests through the
+// scheduler when frame scheduling is enabled and otherwise behaves like the
+// default one.
+struct frame_scheduled_external_interface : alia::default_external_interface
+{
+    frame_scheduled_external_interface(alia::system& owner)
+        : default_external_interface(owner)
+    {
+    }
+
+    ~frame_scheduled_external_interface()
+    {
+        cancel_frame_refresh(this->owner);
+    }
+
+    void
+    schedule_animation_refresh()
+    {
+        if (is_frame_scheduling_enabled())
+            request_frame_refresh(this->owner);
+        else
+            schedule_unaligned_refresh();
+    }
+
+    void
+    request_refresh()
+    {
+        if (is_frame_scheduling_enabled())
+            request_frame_refresh(this->owner);
+        else
+            alia::refresh_system(this->owner);
+    }
+
+    // This is what schedule_animation_refresh() does without frame scheduling.
+    virtual void
+    schedule_unaligned_refresh()
+    {
+    }
+};
+
+} // namespace dom
+
+#endif
@@ -0,0 +1,915 @@
+#include "headless_dom.hpp"
+#include "html.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <sstream>
+
+namespace dom {
+
+headless_value
+headless_value::null()
+{
+    headless_value value;
+    value.kind_ = kind::NULL_VALUE;
+    return value;
+}
+
+headless_value
+headless_value::object()
+{
+    headless_value value;
+    value.kind_ = kind::OBJECT;
+    value.object_ = std::make_shared<object_type>();
+    return value;
+}
+
+headless_value
+headless_value::operator[](std::string const& name) const
+{
+    if (kind_ == kind::OBJECT)
+    {
+        auto i = object_->find(name);
+        if (i != object_->end())
+            return i->second;
+    }
+    return headless_value();
+}
+
+void
+headless_value::set(std::string const& name, headless_value value) const
+{
+    assert(kind_ == kind::OBJECT);
+    (*object_)[name] = std::move(value);
+}
+
+void
+headless_value::erase(std::string const& name) const
+{
+    assert(kind_ == kind::OBJECT);
+    object_->erase(name);
+}
+
+bool
+headless_value::as_bool() const
+{
+    switch (kind_)
+    {
+        case kind::BOOLEAN:
+        case kind::NUMBER:
+            return number_ != 0;
+        case kind::STRING:
+            return !string_.empty();
+        case kind::OBJECT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+double
+headless_value::as_number() const
+{
+    switch (kind_)
+    {
+        case kind::BOOLEAN:
+        case kind::NUMBER:
+            return number_;
+        case kind::STRING: {
+            std::istringstream s(string_);
+            double n = 0;
+            s >> n;
+            return n;
+        }
+        default:
+            return 0;
+    }
+}
+
+std::string
+headless_value::as_string() const
+{
+    switch (kind_)
+    {
+        case kind::NULL_VALUE:
+            return "null";
+        case kind::BOOLEAN:
+            return number_ != 0 ? "true" : "false";
+        case kind::NUMBER: {
+            std::ostringstream s;
+            s << number_;
+            return s.str();
+        }
+        case kind::STRING:
+            return string_;
+        case kind::OBJECT:
+            return "[object Object]";
+        default:
+            return "undefined";
+    }
+}
+
+std::string const*
+get_attribute(headless_node const& node, std::string const& name)
+{
+    for (auto const& attribute : node.attributes)
+    {
+        if (attribute.first == name)
+            return &attribute.second;
+    }
+    return nullptr;
+}
+
+static void
+detach(headless_node& node)
+{
+    headless_node* parent = node.parent;
+    if (!parent)
+        return;
+    if (node.previous_sibling)
+        node.previous_sibling->next_sibling = node.next_sibling;
+    else
+        parent->first_child = node.next_sibling;
+    if (node.next_sibling)
+        node.next_sibling->previous_sibling = node.previous_sibling;
+    else
+        parent->last_child = node.previous_sibling;
+    node.parent = nullptr;
+    node.previous_sibling = nullptr;
+    node.next_sibling = nullptr;
+}
+
+headless_document::headless_document()
+{
+    body_ = &add_node(allocate_node_id());
+    body_->tag = "body";
+}
+
+headless_node&
+headless_document::add_node(int id)
+{
+    assert(id > 0);
+    if (nodes_.size() <= std::size_t(id))
+        nodes_.resize(id + 1);
+    assert(!nodes_[id]);
+    nodes_[id].reset(new headless_node);
+    nodes_[id]->id = id;
+    ++node_count_;
+    return *nodes_[id];
+}
+
+headless_node*
+headless_document::get_node(int id)
+{
+    return id > 0 && std::size_t(id) < nodes_.size() ? nodes_[id].get()
+                                                      : nullptr;
+}
+
+static headless_node*
+find_element_by_id(headless_node& node, std::string const& id)
+{
+    std::string const* value = get_attribute(node, "id");
+    if (value && *value == id)
+        return &node;
+    for (headless_node* child = node.first_child; child;
+         child = child->next_sibling)
+    {
+        if (headless_node* found = find_element_by_id(*child, id))
+            return found;
+    }
+    return nullptr;
+}
+
+headless_node*
+headless_document::get_element_by_id(std::string const& id)
+{
+    return find_element_by_id(*body_, id);
+}
+
+static bool
+delegates(headless_node const& node, std::string const& type)
+{
+    for (auto const& delegated : node.delegated_events)
+    {
+        if (delegated == type)
+            return true;
+    }
+    return false;
+}
+
+void
+headless_document::dispatch_event(
+    headless_node& target,
+    std::string const& type,
+    headless_value event,
+    bool bubbles)
+{
+    event.set("type", type);
+    event.set("target", target.properties);
+    event.set("bubbles", bubbles);
+
+    // Find the delegating node.
+    headless_node* root = target.parent;
+    while (root && !delegates(*root, type))
+        root = root->parent;
+    if (!root || !this->event_delegate)
+        return;
+
+    // Collect the path first, since the handlers can change the document.
+    std::vector<std::pair<int, headless_node*>> path;
+    for (headless_node* node = &target; node != root; node = node->parent)
+    {
+        path.emplace_back(node->id, node);
+        if (!bubbles)
+            break;
+    }
+
+    for (auto const& step : path)
+    {
+        // Skip nodes that have been removed (and possibly replaced) since the
+        // event started.
+        if (this->get_node(step.first) != step.second)
+            continue;
+        this->event_delegate(step.first, type, event);
+        if (event["cancelBubble"].as<bool>())
+            break;
+    }
+}
+
+void
+headless_document::create_element(int id, char const* tag)
+{
+    if (hydrating_)
+    {
+        pending_nodes_[id] = pending_node{false, tag};
+        return;
+    }
+    if (pool_capacity_ != 0)
+    {
+        auto pooled = pool_.find(tag);
+        if (pooled != pool_.end() && !pooled->second.empty())
+        {
+            if (nodes_.size() <= std::size_t(id))
+                nodes_.resize(id + 1);
+            assert(!nodes_[id]);
+            nodes_[id] = std::move(pooled->second.back());
+            pooled->second.pop_back();
+            nodes_[id]->id = id;
+            ++node_count_;
+            ++pool_stats_.hits;
+            --pool_stats_.size;
+            return;
+        }
+        ++pool_stats_.misses;
+    }
+    add_node(id).tag = tag;
+}
+
+void
+headless_document::create_text_node(int id, char const* text)
+{
+    if (hydrating_)
+        pending_nodes_[id] = pending_node{true, text};
+    else
+        add_node(id).text = text;
+}
+
+void
+headless_document::insert_before(int parent_id, int child_id, int before_id)
+{
+    headless_node& parent = *get_node(parent_id);
+    headless_node* before = get_node(before_id);
+    assert(!before || before->parent == &parent);
+
+    if (hydrating_)
+    {
+        auto pending = pending_nodes_.find(child_id);
+        if (pending != pending_nodes_.end())
+        {
+            pending_node const& info = pending->second;
+            auto cursor = hydration_cursors_.find(&parent);
+            if (cursor != hydration_cursors_.end() && !before)
+            {
+                // If the next existing child matches, adopt it.
+                headless_node* existing = cursor->second;
+                if (existing
+                    && (info.is_text ? existing->is_text()
+                                     : existing->tag == info.tag_or_text))
+                {
+                    cursor->second = existing->next_sibling;
+                    if (!existing->is_text())
+                    {
+                        // A template instance keeps the template's
+                        // attributes.
+                        auto& kept = hydrated_attributes_[existing];
+                        if (info.template_id != 0)
+                        {
+                            for (auto const& attribute :
+                                 templates_.at(info.template_id)->attributes)
+                            {
+                                kept.insert(attribute.first);
+                            }
+                        }
+                    }
+                    if (nodes_.size() <= std::size_t(child_id))
+                        nodes_.resize(child_id + 1);
+                    nodes_[child_id] = std::move(nodes_[existing->id]);
+                    existing->id = child_id;
+                    // (Template instances have no further content to adopt.)
+                    if (!existing->is_text() && info.template_id == 0)
+                        hydration_cursors_[existing] = existing->first_child;
+                    pending_nodes_.erase(pending);
+                    return;
+                }
+                // Otherwise, the new node goes before the rest of the existing
+                // children.
+                before = existing;
+            }
+            if (info.template_id != 0)
+            {
+                instantiate_template(child_id, info.template_id);
+            }
+            else
+            {
+                headless_node& node = add_node(child_id);
+                if (info.is_text)
+                    node.text = info.tag_or_text;
+                else
+                    node.tag = info.tag_or_text;
+            }
+            pending_nodes_.erase(pending);
+        }
+    }
+
+    headless_node& child = *get_node(child_id);
+
+    detach(child);
+
+    child.parent = &parent;
+    child.next_sibling = before;
+    child.previous_sibling = before ? before->previous_sibling
+                                    : parent.last_child;
+    if (child.previous_sibling)
+        child.previous_sibling->next_sibling = &child;
+    else
+        parent.first_child = &child;
+    if (before)
+        before->previous_sibling = &child;
+    else
+        parent.last_child = &child;
+}
+
+void
+headless_document::remove_child(int id)
+{
+    std::unique_ptr<headless_node>& slot = nodes_[id];
+    assert(slot);
+    headless_node& node = *slot;
+
+    detach(node);
+
+    // In the browser, the children would stay attached to the removed node, but
+    // since that node is either gone for good or headed for the pool here,
+    // they're orphaned instead. (The JS side does the same when pooling.)
+    headless_node* child = node.first_child;
+    while (child)
+    {
+        headless_node* next = child->next_sibling;
+        child->parent = nullptr;
+        child->previous_sibling = nullptr;
+        child->next_sibling = nullptr;
+        child = next;
+    }
+    node.first_child = nullptr;
+    node.last_child = nullptr;
+
+    --node_count_;
+
+    if (pool_capacity_ != 0 && !node.is_text()
+        && node.delegated_events.empty() && node.template_nodes.empty())
+    {
+        auto& pooled = pool_[node.tag];
+        if (pooled.size() < pool_capacity_)
+        {
+            // Strip the node back to a freshly created state.
+            node.id = 0;
+            node.attributes.clear();
+            node.style.clear();
+            node.properties = headless_value::object();
+            pooled.push_back(std::move(slot));
+            ++pool_stats_.size;
+            return;
+        }
+    }
+
+    slot.reset();
+}
+
+void
+headless_document::detach_node(int id)
+{
+    detach(*get_node(id));
+}
+
+void
+headless_document::release_node(int id)
+{
+    // Since removed nodes are orphaned here, this is the same as removing it.
+    remove_child(id);
+}
+
+void
+headless_document::configure_node_pool(std::size_t capacity)
+{
+    pool_capacity_ = capacity;
+    pool_.clear();
+    pool_stats_.size = 0;
+}
+
+void
+headless_document::set_attribute(int id, char const* name, char const* value)
+{
+    headless_node& node = *get_node(id);
+    keep_hydrated_attribute(node, name);
+    for (auto& attribute : node.attributes)
+    {
+        if (attribute.first == name)
+        {
+            attribute.second = value;
+            return;
+        }
+    }
+    node.attributes.emplace_back(name, value);
+}
+
+void
+headless_document::remove_attribute(int id, char const* name)
+{
+    auto& attributes = get_node(id)->attributes;
+    for (auto i = attributes.begin(); i != attributes.end(); ++i)
+    {
+        if (i->first == name)
+        {
+            attributes.erase(i);
+            return;
+        }
+    }
+}
+
+void
+headless_document::set_node_value(int id, char const* text)
+{
+    get_node(id)->text = text;
+}
+
+void
+headless_document::set_string_property(
+    int id, char const* name, char const* value)
+{
+    get_node(id)->properties.set(name, value);
+}
+
+void
+headless_document::set_number_property(int id, char const* name, double value)
+{
+    get_node(id)->properties.set(name, value);
+}
+
+void
+headless_document::set_boolean_property(int id, char const* name, bool value)
+{
+    get_node(id)->properties.set(name, value);
+}
+
+void
+headless_document::remove_property(int id, char const* name)
+{
+    get_node(id)->properties.erase(name);
+}
+
+void
+headless_document::delegate_events(int id, char const* event_type)
+{
+    get_node(id)->delegated_events.push_back(event_type);
+}
+
+// Update the 'style' attribute to reflect the node's style properties (as the
+// browser would).
+static void
+write_style_attribute(headless_node& node)
+{
+    std::string text;
+    for (auto const& property : node.style)
+    {
+        if (!text.empty())
+            text += ' ';
+        text += property.first + ": " + property.second + ";";
+    }
+    auto& attributes = node.attributes;
+    for (auto i = attributes.begin(); i != attributes.end(); ++i)
+    {
+        if (i->first == "style")
+        {
+            if (text.empty())
+                attributes.erase(i);
+            else
+                i->second = std::move(text);
+            return;
+        }
+    }
+    if (!text.empty())
+        attributes.emplace_back("style", std::move(text));
+}
+
+void
+headless_document::set_style(int id, char const* name, char const* value)
+{
+    headless_node& node = *get_node(id);
+    keep_hydrated_attribute(node, "style");
+    bool found = false;
+    for (auto& property : node.style)
+    {
+        if (property.first == name)
+        {
+            property.second = value;
+            found = true;
+            break;
+        }
+    }
+    if (!found)
+        node.style.emplace_back(name, value);
+    write_style_attribute(node);
+}
+
+void
+headless_document::remove_style(int id, char const* name)
+{
+    headless_node& node = *get_node(id);
+    auto& style = node.style;
+    for (auto i = style.begin(); i != style.end(); ++i)
+    {
+        if (i->first == name)
+        {
+            style.erase(i);
+            write_style_attribute(node);
+            return;
+        }
+    }
+}
+
+// Split a class attribute into its individual classes.
+static std::vector<std::string>
+split_classes(std::string const& text)
+{
+    std::vector<std::string> classes;
+    std::istringstream stream(text);
+    std::string name;
+    while (stream >> name)
+        classes.push_back(name);
+    return classes;
+}
+
+// Set the class attribute to the given list of classes (as the browser would
+// when the class list is modified).
+static void
+write_class_attribute(
+    headless_node& node, std::vector<std::string> const& classes)
+{
+    std::string text;
+    for (auto const& name : classes)
+    {
+        if (!text.empty())
+            text += ' ';
+        text += name;
+    }
+    for (auto& attribute : node.attributes)
+    {
+        if (attribute.first == "class")
+        {
+            attribute.second = std::move(text);
+            return;
+        }
+    }
+    node.attributes.emplace_back("class", std::move(text));
+}
+
+void
+headless_document::add_class(int id, char const* name)
+{
+    headless_node& node = *get_node(id);
+    keep_hydrated_attribute(node, "class");
+    std::string const* attribute = get_attribute(node, "class");
+    auto classes = attribute ? split_classes(*attribute)
+                             : std::vector<std::string>();
+    for (auto const& existing : classes)
+    {
+        if (existing == name)
+            return;
+    }
+    classes.push_back(name);
+    write_class_attribute(node, classes);
+}
+
+void
+headless_document::remove_class(int id, char const* name)
+{
+    headless_node& node = *get_node(id);
+    std::string const* attribute = get_attribute(node, "class");
+    if (!attribute)
+        return;
+    auto classes = split_classes(*attribute);
+    for (auto i = classes.begin(); i != classes.end(); ++i)
+    {
+        if (*i == name)
+        {
+            classes.erase(i);
+            write_class_attribute(node, classes);
+            return;
+        }
+    }
+}
+
+void
+headless_document::free_subtree(headless_node& node)
+{
+    headless_node* child = node.first_child;
+    while (child)
+    {
+        headless_node* next = child->next_sibling;
+        free_subtree(*child);
+        child = next;
+    }
+    // (Template descendants are freed along with their owner.)
+    if (node.id != 0)
+    {
+        nodes_[node.id].reset();
+        --node_count_;
+    }
+}
+
+static void
+append_child(headless_node& parent, headless_node& child)
+{
+    child.parent = &parent;
+    child.previous_sibling = parent.last_child;
+    if (parent.last_child)
+        parent.last_child->next_sibling = &child;
+    else
+        parent.first_child = &child;
+    parent.last_child = &child;
+}
+
+static std::string
+decode_entities(char const* begin, char const* end)
+{
+    static std::pair<char const*, char> const entities[]
+        = {{"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}};
+    std::string text;
+    for (char const* p = begin; p != end; ++p)
+    {
+        bool decoded = false;
+        if (*p == '&')
+        {
+            for (auto const& entity : entities)
+            {
+                std::size_t length = std::strlen(entity.first);
+                if (std::size_t(end - p) >= length
+                    && std::strncmp(p, entity.first, length) == 0)
+                {
+                    text += entity.second;
+                    p += length - 1;
+                    decoded = true;
+                    break;
+                }
+            }
+        }
+        if (!decoded)
+            text += *p;
+    }
+    return text;
+}
+
+void
+parse_html(char const* html, headless_node& root)
+{
+    std::vector<headless_node*> open_elements;
+    char const* p = html;
+    while (*p)
+    {
+        if (p[0] == '<' && p[1] == '!')
+        {
+            // comment
+            char const* end = std::strstr(p, "-->");
+            p = end ? end + 3 : p + std::strlen(p);
+        }
+        else if (p[0] == '<' && p[1] == '/')
+        {
+            // closing tag
+            p = std::strchr(p, '>') + 1;
+            if (!open_elements.empty())
+                open_elements.pop_back();
+        }
+        else if (p[0] == '<')
+        {
+            // opening tag
+            headless_node* node = &root;
+            if (!open_elements.empty())
+            {
+                root.template_nodes.emplace_back(new headless_node);
+                node = root.template_nodes.back().get();
+                append_child(*open_elements.back(), *node);
+            }
+            ++p;
+            std::size_t name_length = std::strcspn(p, " >");
+            node->tag.assign(p, name_length);
+            p += name_length;
+            while (*p == ' ')
+            {
+                ++p;
+                char const* equals = std::strchr(p, '=');
+                std::string name(p, equals);
+                char const* value = equals + 2;
+                char const* value_end = std::strchr(value, '"');
+                node->attributes.emplace_back(
+                    name, decode_entities(value, value_end));
+                p = value_end + 1;
+            }
+            ++p;
+            if (!is_void_element(node->tag))
+                open_elements.push_back(node);
+        }
+        else
+        {
+            // text
+            char const* end = p + std::strcspn(p, "<");
+            if (!open_elements.empty())
+            {
+                root.template_nodes.emplace_back(new headless_node);
+                headless_node& node = *root.template_nodes.back();
+                node.text = decode_entities(p, end);
+                append_child(*open_elements.back(), node);
+            }
+            p = end;
+        }
+    }
+}
+
+// Clone the descendants of :source into :target. :owner takes ownership of the
+// clones.
+static void
+clone_children(
+    headless_node const& source, headless_node& target, headless_node& owner)
+{
+    for (headless_node const* child = source.first_child; child;
+         child = child->next_sibling)
+    {
+        owner.template_nodes.emplace_back(new headless_node);
+        headless_node& clone = *owner.template_nodes.back();
+        clone.tag = child->tag;
+        clone.text = child->text;
+        clone.attributes = child->attributes;
+        append_child(target, clone);
+        clone_children(*child, clone, owner);
+    }
+}
+
+void
+headless_document::define_template(int template_id, char const* html)
+{
+    std::unique_ptr<headless_node> root(new headless_node);
+    parse_html(html, *root);
+    templates_[template_id] = std::move(root);
+}
+
+void
+headless_document::clone_template(int id, int template_id)
+{
+    if (hydrating_)
+    {
+        pending_node pending{false, templates_.at(template_id)->tag};
+        pending.template_id = template_id;
+        pending_nodes_[id] = std::move(pending);
+        return;
+    }
+    instantiate_template(id, template_id);
+}
+
+void
+headless_document::instantiate_template(int id, int template_id)
+{
+    headless_node const& source = *templates_.at(template_id);
+    headless_node& node = add_node(id);
+    node.tag = source.tag;
+    node.attributes = source.attributes;
+    clone_children(source, node, node);
+}
+
+void
+headless_document::keep_hydrated_attribute(
+    headless_node& node, char const* name)
+{
+    if (!hydrating_)
+        return;
+    auto adopted = hydrated_attributes_.find(&node);
+    if (adopted != hydrated_attributes_.end())
+        adopted->second.insert(name);
+}
+
+void
+headless_document::begin_hydration(int id)
+{
+    hydrating_ = true;
+    headless_node& root = *get_node(id);
+    hydration_cursors_[&root] = root.first_child;
+}
+
+void
+headless_document::end_hydration(int id)
+{
+    // Remove any existing content that wasn't adopted.
+    for (auto const& cursor : hydration_cursors_)
+    {
+        headless_node* node = cursor.second;
+        while (node)
+        {
+            headless_node* next = node->next_sibling;
+            detach(*node);
+            free_subtree(*node);
+            node = next;
+        }
+    }
+    hydration_cursors_.clear();
+
+    // Remove any existing attributes that the adopted elements didn't set.
+    for (auto const& adopted : hydrated_attributes_)
+    {
+        headless_node& node = *adopted.first;
+        auto const& kept = adopted.second;
+        auto& attributes = node.attributes;
+        attributes.erase(
+            std::remove_if(
+                attributes.begin(),
+                attributes.end(),
+                [&](auto const& attribute) {
+                    return kept.count(attribute.first) == 0;
+                }),
+            attributes.end());
+        if (kept.count("style") == 0)
+            node.style.clear();
+    }
+    hydrated_attributes_.clear();
+
+    pending_nodes_.clear();
+    hydrating_ = false;
+}
+
+headless_document&
+get_headless_document()
+{
+    static headless_document the_document;
+    return the_document;
+}
+
+void
+write_html(std::ostream& out, headless_node const& node)
+{
+    if (node.is_text())
+    {
+        write_escaped_html(out, node.text, false);
+        return;
+    }
+
+    out << "<" << node.tag;
+    for (auto const& attribute : node.attributes)
+    {
+        out << " " << attribute.first << "=\"";
+        write_escaped_html(out, attribute.second, true);
+        out << "\"";
+    }
+    out << ">";
+
+    if (is_void_element(node.tag))
+        return;
+
+    write_inner_html(out, node);
+
+    out << "</" << node.tag << ">";
+}
+
+void
+write_inner_html(std::ostream& out, headless_node const& node)
+{
+    for (headless_node const* child = node.first_child; child;
+         child = child->next_sibling)
+    {
+        if (child->is_text() && child->previous_sibling
+            && child->previous_sibling->is_text())
+        {
+            out << "<!---->";
+        }
+        write_html(out, *child);
+    }
+}
+
+} // namespace dom
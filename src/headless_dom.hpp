@@ -0,0 +1,358 @@
+#ifndef HEADLESS_DOM_HPP
+#define HEADLESS_DOM_HPP
+
+#include "command_buffer.hpp"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// This file provides an in-memory stand-in for the browser DOM. It's what the
+// DOM layer targets when it's built natively (i.e., without emscripten), which
+// allows the UI layer to be run, profiled and benchmarked with native tools.
+//
+// The document is driven by the same command stream that's normally sent to
+// JS, so it implements the same semantics: createElement, createTextNode,
+// insertBefore, removeChild, setAttribute/removeAttribute, setting a node's
+// value, setting/removing individual style properties and adding/removing
+// classes. Event delegation is
+// modeled as well: a node can be marked as delegating a type of event, and
+// events of that type that are dispatched within its subtree are passed along
+// to the document's event_delegate.
+
+namespace dom {
+
+// headless_value is a (very) small model of a JS value. It fills the role that
+// emscripten::val plays in the real backend: it's what gets passed to event
+// handlers and what properties are stored as.
+struct headless_value
+{
+    enum class kind
+    {
+        UNDEFINED,
+        NULL_VALUE,
+        BOOLEAN,
+        NUMBER,
+        STRING,
+        OBJECT
+    };
+
+    typedef std::map<std::string, headless_value> object_type;
+
+    headless_value()
+    {
+    }
+    headless_value(bool value) : kind_(kind::BOOLEAN), number_(value ? 1 : 0)
+    {
+    }
+    template<
+        class Number,
+        std::enable_if_t<
+            std::is_arithmetic<Number>::value
+                && !std::is_same<Number, bool>::value,
+            int> = 0>
+    headless_value(Number value) : kind_(kind::NUMBER), number_(double(value))
+    {
+    }
+    headless_value(std::string value)
+        : kind_(kind::STRING), string_(std::move(value))
+    {
+    }
+    headless_value(char const* value) : kind_(kind::STRING), string_(value)
+    {
+    }
+
+    static headless_value
+    null();
+
+    // Objects have reference semantics (as they do in JS), so copies of an
+    // object value all refer to the same object.
+    static headless_value
+    object();
+
+    kind
+    type() const
+    {
+        return kind_;
+    }
+
+    bool
+    isNull() const
+    {
+        return kind_ == kind::NULL_VALUE;
+    }
+
+    bool
+    isUndefined() const
+    {
+        return kind_ == kind::UNDEFINED;
+    }
+
+    // Get a property of an object. (Anything missing is undefined.)
+    headless_value
+    operator[](std::string const& name) const;
+
+    // Set/delete a property of an object.
+    void
+    set(std::string const& name, headless_value value) const;
+    void
+    erase(std::string const& name) const;
+
+    template<class T>
+    T
+    as() const
+    {
+        if constexpr (std::is_same<T, std::string>::value)
+            return as_string();
+        else if constexpr (std::is_same<T, bool>::value)
+            return as_bool();
+        else
+            return T(as_number());
+    }
+
+ private:
+    bool
+    as_bool() const;
+
+    double
+    as_number() const;
+
+    std::string
+    as_string() const;
+
+    kind kind_ = kind::UNDEFINED;
+    double number_ = 0;
+    std::string string_;
+    std::shared_ptr<object_type> object_;
+};
+
+struct headless_node
+{
+    int id = 0;
+
+    // Text nodes have an empty tag.
+    std::string tag;
+    bool
+    is_text() const
+    {
+        return tag.empty();
+    }
+
+    // the node value (for text nodes)
+    std::string text;
+
+    // attributes, in the order in which they were first set
+    std::vector<std::pair<std::string, std::string>> attributes;
+
+    // inline style properties, in the order in which they were first set
+    // (The 'style' attribute is kept in sync with these.)
+    std::vector<std::pair<std::string, std::string>> style;
+
+    // properties that have been set directly on the node (an object)
+    headless_value properties = headless_value::object();
+
+    // the types of events that this node delegates
+    std::vector<std::string> delegated_events;
+
+    // If this node was cloned from a template, this owns its descendants.
+    // (They're not assigned IDs, since nothing refers to them individually.)
+    std::vector<std::unique_ptr<headless_node>> template_nodes;
+
+    headless_node* parent = nullptr;
+    headless_node* first_child = nullptr;
+    headless_node* last_child = nullptr;
+    headless_node* previous_sibling = nullptr;
+    headless_node* next_sibling = nullptr;
+};
+
+// Get the value of an attribute (or null if it's not set).
+std::string const*
+get_attribute(headless_node const& node, std::string const& name);
+
+struct headless_document : command_handler
+{
+    headless_document();
+
+    // the <body> of the document
+    headless_node&
+    body()
+    {
+        return *body_;
+    }
+
+    // Get the node with the given ID (or null if there isn't one).
+    headless_node*
+    get_node(int id);
+
+    // Find the element in the document (i.e., attached to the body) with the
+    // given 'id' attribute.
+    headless_node*
+    get_element_by_id(std::string const& id);
+
+    // the number of nodes currently allocated (whether attached or not)
+    // (This doesn't include the descendants of cloned templates.)
+    std::size_t
+    node_count() const
+    {
+        return node_count_;
+    }
+
+    // statistics for the node pool (See command_buffer.hpp.)
+    node_pool_stats const&
+    pool_stats() const
+    {
+        return pool_stats_;
+    }
+    void
+    reset_pool_stats()
+    {
+        pool_stats_.hits = 0;
+        pool_stats_.misses = 0;
+    }
+
+    // Dispatch an event to a node. :event should be an object. Its 'type',
+    // 'target' and 'bubbles' properties are filled in here.
+    //
+    // As in the browser, the delegating ancestor sees the event first (in the
+    // capture phase). It's passed to event_delegate for the target and then,
+    // if :bubbles is set, for each of the target's ancestors (up to the
+    // delegating node) until one of the handlers sets 'cancelBubble'.
+    void
+    dispatch_event(
+        headless_node& target,
+        std::string const& type,
+        headless_value event,
+        bool bubbles = true);
+
+    // This receives delegated events (with the ID of the node that the event
+    // is being delivered to).
+    std::function<void(int node, std::string const& type, headless_value event)>
+        event_delegate;
+
+    // command_handler implementation
+    void
+    create_element(int id, char const* tag);
+    void
+    create_text_node(int id, char const* text);
+    void
+    insert_before(int parent, int child, int before);
+    void
+    remove_child(int id);
+    void
+    detach_node(int id);
+    void
+    release_node(int id);
+    void
+    set_attribute(int id, char const* name, char const* value);
+    void
+    remove_attribute(int id, char const* name);
+    void
+    set_node_value(int id, char const* text);
+    void
+    set_string_property(int id, char const* name, char const* value);
+    void
+    set_number_property(int id, char const* name, double value);
+    void
+    set_boolean_property(int id, char const* name, bool value);
+    void
+    remove_property(int id, char const* name);
+    void
+    delegate_events(int id, char const* event_type);
+    void
+    set_style(int id, char const* name, char const* value);
+    void
+    remove_style(int id, char const* name);
+    void
+    add_class(int id, char const* name);
+    void
+    remove_class(int id, char const* name);
+    void
+    define_template(int template_id, char const* html);
+    void
+    clone_template(int id, int template_id);
+    void
+    begin_hydration(int id);
+    void
+    end_hydration(int id);
+    void
+    configure_node_pool(std::size_t capacity);
+
+ private:
+    headless_node&
+    add_node(int id);
+
+    void
+    free_subtree(headless_node& node);
+
+    // Create the node with the given ID as a clone of a template.
+    void
+    instantiate_template(int id, int template_id);
+
+    // Record that an attribute has been set on a node. (If the node has been
+    // adopted by the current hydration, it keeps that attribute.)
+    void
+    keep_hydrated_attribute(headless_node& node, char const* name);
+
+    // hydration state
+    // While hydrating, newly created nodes are left pending until they're
+    // inserted, at which point they either adopt an existing node or are
+    // actually created.
+    struct pending_node
+    {
+        bool is_text;
+        std::string tag_or_text;
+        // If this is nonzero, the node is an instance of this template.
+        int template_id = 0;
+    };
+    bool hydrating_ = false;
+    std::map<int, pending_node> pending_nodes_;
+    // for each parent that's being hydrated, the next child to adopt
+    std::map<headless_node*, headless_node*> hydration_cursors_;
+    // for each element that's been adopted, the attributes that have been set
+    // on it since (Any others came from the existing content and are removed
+    // at the end.)
+    std::map<headless_node*, std::set<std::string>> hydrated_attributes_;
+
+    // templates, by ID
+    // (Like clones, each template owns its descendants.)
+    std::map<int, std::unique_ptr<headless_node>> templates_;
+
+    // node pool - removed elements, by tag
+    std::size_t pool_capacity_ = 0;
+    std::map<std::string, std::vector<std::unique_ptr<headless_node>>> pool_;
+    node_pool_stats pool_stats_;
+
+    std::vector<std::unique_ptr<headless_node>> nodes_;
+    std::size_t node_count_ = 0;
+    headless_node* body_;
+};
+
+// Get the document that the headless backend targets.
+headless_document&
+get_headless_document();
+
+// Write the HTML representation of a node (and its descendants).
+// Since the HTML parser would merge adjacent text nodes, they're separated by
+// empty comments.
+void
+write_html(std::ostream& out, headless_node const& node);
+
+// Write the HTML representation of a node's descendants.
+void
+write_inner_html(std::ostream& out, headless_node const& node);
+
+// Parse HTML into :root (which takes ownership of its descendants, as with a
+// template). This only handles the HTML that write_html() and static fragments
+// generate (i.e., a single root element, with all attribute values quoted).
+void
+parse_html(char const* html, headless_node& root);
+
+} // namespace dom
+
+#endif
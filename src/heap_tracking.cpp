@@ -0,0 +1,119 @@
+#include "heap_tracking.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace dom {
+
+static heap_usage usage;
+
+heap_usage
+get_heap_usage()
+{
+    return usage;
+}
+
+void
+reset_heap_peak()
+{
+    usage.peak = usage.current;
+    usage.allocations = 0;
+}
+
+// Each block is prefixed with a header that records its size. The header
+// occupies a whole alignment unit so that the block itself stays aligned.
+static void*
+tracked_allocate(std::size_t size, std::size_t alignment)
+{
+    if (alignment < alignof(std::max_align_t))
+        alignment = alignof(std::max_align_t);
+    // aligned_alloc() requires the size to be a multiple of the alignment.
+    std::size_t total
+        = (alignment + size + alignment - 1) / alignment * alignment;
+    char* block = static_cast<char*>(std::aligned_alloc(alignment, total));
+    if (!block)
+        throw std::bad_alloc();
+    char* p = block + alignment;
+    reinterpret_cast<std::size_t*>(p)[-1] = size;
+    reinterpret_cast<std::size_t*>(p)[-2] = alignment;
+    usage.current += size;
+    if (usage.current > usage.peak)
+        usage.peak = usage.current;
+    ++usage.allocations;
+    return p;
+}
+
+static void
+tracked_free(void* p)
+{
+    if (!p)
+        return;
+    std::size_t size = static_cast<std::size_t*>(p)[-1];
+    std::size_t alignment = static_cast<std::size_t*>(p)[-2];
+    usage.current -= size;
+    std::free(static_cast<char*>(p) - alignment);
+}
+
+} // namespace dom
+
+void*
+operator new(std::size_t size)
+{
+    return dom::tracked_allocate(size, 0);
+}
+void*
+operator new[](std::size_t size)
+{
+    return dom::tracked_allocate(size, 0);
+}
+void*
+operator new(std::size_t size, std::align_val_t alignment)
+{
+    return dom::tracked_allocate(size, std::size_t(alignment));
+}
+void*
+operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return dom::tracked_allocate(size, std::size_t(alignment));
+}
+
+void
+operator delete(void* p) noexcept
+{
+    dom::tracked_free(p);
+}
+void
+operator delete[](void* p) noexcept
+{
+    dom::tracked_free(p);
+}
+void
+operator delete(void* p, std::size_t) noexcept
+{
+    dom::tracked_free(p);
+}
+void
+operator delete[](void* p, std::size_t) noexcept
+{
+    dom::tracked_free(p);
+}
+void
+operator delete(void* p, std::align_val_t) noexcept
+{
+    dom::tracked_free(p);
+}
+void
+operator delete[](void* p, std::align_val_t) noexcept
+{
+    dom::tracked_free(p);
+}
+void
+operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+    dom::tracked_free(p);
+}
+void
+operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+    dom::tracked_free(p);
+}
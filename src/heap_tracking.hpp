@@ -0,0 +1,40 @@
+#ifndef HEAP_TRACKING_HPP
+#define HEAP_TRACKING_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// This file provides heap accounting for native benchmarks.
+//
+// heap_tracking.cpp replaces the global operator new and delete with versions
+// that keep track of how many bytes are in use, so it should only be linked
+// into native builds that are used for benchmarking heap usage (i.e.,
+// main-headless-heap). It adds its own overhead to every allocation, so it
+// shouldn't be used for builds that are profiled with other tools.
+//
+// Only memory that goes through operator new is counted (which, in practice,
+// is everything that the DOM layer and alia allocate), and only the bytes that
+// were requested are counted, not the heap's own per-allocation overhead.
+
+namespace dom {
+
+struct heap_usage
+{
+    // the number of bytes currently allocated
+    std::size_t current = 0;
+    // the maximum value of :current since the last reset
+    std::size_t peak = 0;
+    // the number of allocations since the last reset
+    std::uint64_t allocations = 0;
+};
+
+heap_usage
+get_heap_usage();
+
+// Reset the peak to the current usage and the allocation count to 0.
+void
+reset_heap_peak();
+
+} // namespace dom
+
+#endif
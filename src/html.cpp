@@ -0,0 +1,60 @@
+#include "html.hpp"
+
+namespace dom {
+
+void
+write_escaped_html(
+    std::ostream& out, std::string const& text, bool in_attribute)
+{
+    for (char c : text)
+    {
+        switch (c)
+        {
+            case '&':
+                out << "&amp;";
+                break;
+            case '<':
+                out << "&lt;";
+                break;
+            case '>':
+                out << "&gt;";
+                break;
+            case '"':
+                if (in_attribute)
+                    out << "&quot;";
+                else
+                    out << c;
+                break;
+            default:
+                out << c;
+        }
+    }
+}
+
+bool
+is_void_element(std::string const& tag)
+{
+    static char const* const void_elements[]
+        = {"area",
+           "base",
+           "br",
+           "col",
+           "embed",
+           "hr",
+           "img",
+           "input",
+           "link",
+           "meta",
+           "param",
+           "source",
+           "track",
+           "wbr"};
+    for (char const* name : void_elements)
+    {
+        if (tag == name)
+            return true;
+    }
+    return false;
+}
+
+} // namespace dom
@@ -0,0 +1,24 @@
+#ifndef HTML_HPP
+#define HTML_HPP
+
+#include <ostream>
+#include <string>
+
+// This file provides the bits of HTML serialization that are shared between
+// the headless document and static fragments.
+
+namespace dom {
+
+// Write :text with the characters that are special in HTML escaped.
+// If :in_attribute is set, double quotes are escaped as well.
+void
+write_escaped_html(
+    std::ostream& out, std::string const& text, bool in_attribute);
+
+// Is :tag a void element (i.e., one that has no closing tag)?
+bool
+is_void_element(std::string const& tag);
+
+} // namespace dom
+
+#endif
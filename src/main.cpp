@@ -2,16 +2,21 @@
 // Use of this source code is governed by the MIT license that can be found in
 // the LICENSE file.
 
+#ifdef __EMSCRIPTEN__
 #include <emscripten/emscripten.h>
 #include <emscripten/fetch.h>
 #include <emscripten/val.h>
+#endif
 
 #include <functional>
 #include <iostream>
 #include <string>
 
+#include <algorithm>
 #include <chrono>
+#include <cstdlib>
 #include <ctime>
+#include <random>
 
 #define ALIA_IMPLEMENTATION
 #define ALIA_LOWERCASE_MACROS
@@ -19,6 +24,11 @@
 
 #include "color.hpp"
 #include "dom.hpp"
+#include "multi_root_host.hpp"
+
+#ifdef DOM_HEAP_TRACKING
+#include "heap_tracking.hpp"
+#endif
 
 using std::string;
 
@@ -243,16 +253,500 @@ do_content_ui(dom::context ctx)
     // schedule_animation_refresh(ctx);
 }
 
+#ifdef DOM_HEADLESS
+
+// In headless builds, main() runs the same controllers against the in-memory
+// document and reports how long refreshes take. This makes it possible to use
+// native profiling tools (perf, valgrind, heaptrack, etc.) on the UI layer.
+//
+// usage: main-headless [refresh-count]
+//        main-headless --html
+//        main-headless --event-burst [event-count]
+//        main-headless --multi-root [tick-count]
+//        main-headless --teardown [node-count]
+//        main-headless --naming-map
+//        main-headless-heap --for-each [row-count]
+//        main-headless-heap --list-edits [block-count]
+//
+// With --html, it just renders the content UI to HTML (as a server would) and
+// prints it.
+//
+// With --event-burst, it measures how a burst of 'input' events is handled
+// with and without event coalescing.
+//
+// With --multi-root, it mounts the nav and content UIs side by side in a
+// multi_root_host, refreshes both on every tick and reports the timing for
+// each root.
+//
+// The modes that report heap usage are only available in main-headless-heap,
+// which is built with heap tracking (see heap_tracking.hpp).
+//
+// With --for-each, it builds and tears down a large for_each view and reports
+// the time and peak heap usage for each.
+//
+// With --teardown, it builds a data graph with a single block of :node-count
+// nodes and a for_each view with a tenth as many rows, and then reports how
+// long it takes to destroy each (and how many DOM removals the view issues).
+//
+// With --naming-map, it measures named block lookups that miss the prediction
+// (because the blocks are shuffled on every pass) at 1k, 10k and 100k blocks,
+// for both hashable IDs and IDs that fall back to ordered lookups.
+//
+// With --list-edits, it traverses a list of :block-count named blocks, applies
+// small edits to the list (inserting at the head, removing from the head,
+// swapping, etc.) and reports the time and heap allocations of the pass that
+// follows each edit.
+//
+
+static int burst_refresh_count = 0;
+
+static void
+do_burst_ui(dom::context ctx)
+{
+    on_refresh(ctx, [](auto ctx) { ++burst_refresh_count; });
+    auto value = get_state(ctx, string());
+    input(ctx, value);
+    // Give the refreshes something to do.
+    for (int i = 0; i != 100; ++i)
+        text(ctx, value);
+}
+
+// Send :event_count 'input' events to the burst UI (all within one frame) and
+// report the number of refreshes and the time that it took.
+static void
+run_event_burst(int event_count, bool coalesce)
+{
+    auto& document = get_headless_document();
+    auto& buffer = get_command_buffer();
+    mount_placeholder(document, buffer, "burst-root");
+
+    manual_frame_clock clock;
+    if (coalesce)
+        set_frame_clock(&clock);
+
+    {
+        dom::system dom_system;
+        alia::system alia_system;
+        initialize(dom_system, alia_system, "burst-root", do_burst_ui);
+        headless_node& input
+            = *document.get_node(dom_system.root_node.object.js_id)
+                   ->first_child;
+
+        burst_refresh_count = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i != event_count; ++i)
+        {
+            input.properties.set("value", std::to_string(i));
+            document.dispatch_event(input, "input", headless_value::object());
+        }
+        clock.advance(16);
+        auto end = std::chrono::steady_clock::now();
+
+        auto total_us
+            = std::chrono::duration_cast<std::chrono::microseconds>(
+                  end - start)
+                  .count();
+        std::cout << (coalesce ? "coalesced: " : "immediate: ") << event_count
+                  << " events, " << burst_refresh_count << " refreshes, "
+                  << total_us << " us" << std::endl;
+    }
+
+    set_frame_clock(nullptr);
+    flush_commands(buffer);
+}
+
+// Mount the nav and content UIs in a host and run :tick_count ticks.
+static void
+run_multi_root(int tick_count)
+{
+    auto& document = get_headless_document();
+    auto& buffer = get_command_buffer();
+    mount_placeholder(document, buffer, "nav-root");
+    mount_placeholder(document, buffer, "content-root");
+
+    multi_root_host host;
+    host.mount("nav-root", do_nav_ui);
+    host.mount("content-root", do_content_ui);
+
+    for (int i = 0; i != tick_count; ++i)
+    {
+        for (auto const& root : host.roots())
+            root->dirty = true;
+        host.tick();
+    }
+
+    auto const& stats = host.stats();
+    std::cout << stats.ticks << " ticks, max flush: " << stats.max_flush_time
+              << " ms" << std::endl;
+    for (auto const& root : host.roots())
+    {
+        auto const& root_stats = root->stats;
+        std::cout << root->dom_node_id << ": " << root_stats.refreshes
+                  << " refreshes, "
+                  << (root_stats.refreshes != 0
+                          ? root_stats.total_refresh_time
+                                / root_stats.refreshes
+                          : 0)
+                  << " ms/refresh (max " << root_stats.max_refresh_time
+                  << " ms)" << std::endl;
+    }
+}
+
+static std::vector<std::string> benchmark_rows;
+
+static void
+do_for_each_ui(dom::context ctx)
+{
+    element(ctx, "ul").children([&](auto ctx) {
+        for_each(ctx, benchmark_rows, [&](auto ctx, auto const& row) {
+            auto selected = get_state(ctx, false);
+            element(ctx, "li")
+                .attr("class", conditional(selected, "selected", "row"))
+                .text(row);
+        });
+    });
+}
+
+#ifdef DOM_HEAP_TRACKING
+
+static void
+report_phase(
+    char const* label,
+    std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point end,
+    std::size_t heap_baseline)
+{
+    auto usage = get_heap_usage();
+    std::cout << label << ": "
+              << std::chrono::duration_cast<std::chrono::microseconds>(
+                     end - start)
+                     .count()
+              << " us, " << usage.allocations << " allocations, peak heap "
+              << (usage.peak - heap_baseline) / 1024 << " KiB" << std::endl;
+}
+
+// Build a for_each view with :row_count rows and then tear it down.
+static void
+run_for_each_benchmark(int row_count)
+{
+    auto& document = get_headless_document();
+    auto& buffer = get_command_buffer();
+    mount_placeholder(document, buffer, "for-each-root");
+
+    for (int i = 0; i != row_count; ++i)
+        benchmark_rows.push_back("row " + std::to_string(i));
+
+    auto* dom_system = new dom::system;
+    auto* alia_system = new alia::system;
+
+    // (Peak heap usage is reported relative to the usage before construction.)
+    auto heap_baseline = get_heap_usage().current;
+    reset_heap_peak();
+    auto start = std::chrono::steady_clock::now();
+    initialize(*dom_system, *alia_system, "for-each-root", do_for_each_ui);
+    auto end = std::chrono::steady_clock::now();
+    report_phase("construction", start, end, heap_baseline);
+    std::cout << "  " << (get_heap_usage().current - heap_baseline) / 1024
+              << " KiB retained, " << document.node_count() << " nodes"
+              << std::endl;
+
+    reset_heap_peak();
+    start = std::chrono::steady_clock::now();
+    // (The alia::system refers to the dom::system, so it goes first.)
+    delete alia_system;
+    delete dom_system;
+    flush_commands(buffer);
+    end = std::chrono::steady_clock::now();
+    report_phase("destruction", start, end, heap_baseline);
+    std::cout << "  " << (get_heap_usage().current - heap_baseline) / 1024
+              << " KiB still allocated" << std::endl;
+}
+
+#endif
+
+// Build and destroy a long flat data block and a large for_each view.
+static void
+run_teardown_benchmark(int node_count)
+{
+    auto* graph = new data_graph;
+    {
+        data_traversal traversal;
+        scoped_data_traversal scoped(*graph, traversal);
+        for (int i = 0; i != node_count; ++i)
+            get_data<int>(traversal) = i;
+    }
+    auto start = std::chrono::steady_clock::now();
+    delete graph;
+    auto end = std::chrono::steady_clock::now();
+    std::cout << "data block with " << node_count << " nodes: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(
+                     end - start)
+                     .count()
+              << " us" << std::endl;
+
+    auto& document = get_headless_document();
+    auto& buffer = get_command_buffer();
+    mount_placeholder(document, buffer, "teardown-root");
+
+    for (int i = 0; i != node_count / 10; ++i)
+        benchmark_rows.push_back("row " + std::to_string(i));
+
+    auto* dom_system = new dom::system;
+    auto* alia_system = new alia::system;
+    initialize(*dom_system, *alia_system, "teardown-root", do_for_each_ui);
+    auto dom_node_count = document.node_count();
+
+    mutation_counts before = buffer.mutations;
+    start = std::chrono::steady_clock::now();
+    delete alia_system;
+    delete dom_system;
+    flush_commands(buffer);
+    end = std::chrono::steady_clock::now();
+    std::cout << "for_each view with " << benchmark_rows.size() << " rows ("
+              << dom_node_count << " DOM nodes): "
+              << std::chrono::duration_cast<std::chrono::microseconds>(
+                     end - start)
+                     .count()
+              << " us, " << (buffer.mutations - before).removals
+              << " removals, " << document.node_count() << " nodes left"
+              << std::endl;
+}
+
+// a key without a std::hash, so naming maps fall back to ordered lookups
+struct unhashable_key
+{
+    int value;
+};
+static bool
+operator==(unhashable_key a, unhashable_key b)
+{
+    return a.value == b.value;
+}
+static bool
+operator<(unhashable_key a, unhashable_key b)
+{
+    return a.value < b.value;
+}
+
+// Traverse :block_count named blocks (keyed by Key) in a different random
+// order on each pass and report the average time per block.
+template<class Key>
+static void
+run_naming_map_benchmark(char const* label, int block_count)
+{
+    std::vector<int> order(block_count);
+    for (int i = 0; i != block_count; ++i)
+        order[i] = i;
+
+    data_graph graph;
+    auto traverse = [&]() {
+        data_traversal traversal;
+        scoped_data_traversal scoped(graph, traversal);
+        naming_context nc(traversal);
+        for (int i : order)
+        {
+            named_block nb(nc, make_id(Key{i}));
+            get_data<int>(traversal) = i;
+        }
+    };
+    traverse();
+
+    std::mt19937 rng(1);
+    int const pass_count = 10;
+    std::chrono::steady_clock::duration total(0);
+    for (int pass = 0; pass != pass_count; ++pass)
+    {
+        std::shuffle(order.begin(), order.end(), rng);
+        auto start = std::chrono::steady_clock::now();
+        traverse();
+        total += std::chrono::steady_clock::now() - start;
+    }
+    std::cout << label << ", " << block_count << " blocks: "
+              << std::chrono::duration<double, std::nano>(total).count()
+                     / (double(pass_count) * block_count)
+              << " ns/block" << std::endl;
+}
+
+#ifdef DOM_HEAP_TRACKING
+
+// Traverse a list of :block_count named blocks and then apply a series of
+// small edits to it, reporting the cost of the pass that follows each one.
+static void
+run_list_edit_benchmark(int block_count)
+{
+    std::vector<int> order(block_count);
+    for (int i = 0; i != block_count; ++i)
+        order[i] = i;
+    int next_key = block_count;
+
+    data_graph graph;
+    auto traverse = [&]() {
+        data_traversal traversal;
+        scoped_data_traversal scoped(graph, traversal);
+        naming_context nc(traversal);
+        for (int i : order)
+        {
+            named_block nb(nc, make_id(i));
+            get_data<int>(traversal) = i;
+        }
+    };
+    traverse();
+
+    auto measure = [&](char const* label) {
+        reset_heap_peak();
+        auto start = std::chrono::steady_clock::now();
+        traverse();
+        auto end = std::chrono::steady_clock::now();
+        std::cout << label << ": "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(
+                         end - start)
+                         .count()
+                  << " us, " << get_heap_usage().allocations << " allocations"
+                  << std::endl;
+    };
+
+    measure("unchanged");
+    order.insert(order.begin(), next_key++);
+    measure("insert at head");
+    order.erase(order.begin());
+    measure("remove from head");
+    std::swap(order[0], order[1]);
+    measure("swap first two");
+    order.insert(order.begin() + block_count / 2, next_key++);
+    measure("insert in middle");
+    std::rotate(order.begin(), order.end() - 1, order.end());
+    measure("move last to head");
+    order.erase(order.begin(), order.begin() + 4);
+    measure("remove four from head");
+}
+
+#endif
+
 int
-main()
+main(int argc, char** argv)
 {
-    // static alia::system nav_sys;
-    // static dom::system nav_dom;
-    // initialize(nav_dom, nav_sys, "nav-root", do_nav_ui);
+    // Mutations are applied to the headless document. (The backend installs
+    // this when a system is attached, but placeholders are mounted before
+    // that.)
+    auto& document = get_headless_document();
+    auto& buffer = get_command_buffer();
+    buffer.executor = [&](std::uint32_t const* words, std::size_t size) {
+        decode_commands(words, size, document);
+    };
+
+    if (argc > 1 && std::string(argv[1]) == "--html")
+    {
+        std::cout << render_to_html(do_content_ui) << std::endl;
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--event-burst")
+    {
+        int event_count = argc > 2 ? std::atoi(argv[2]) : 1000;
+        run_event_burst(event_count, false);
+        run_event_burst(event_count, true);
+        return 0;
+    }
+
+#ifdef DOM_HEAP_TRACKING
+    if (argc > 1 && std::string(argv[1]) == "--for-each")
+    {
+        run_for_each_benchmark(argc > 2 ? std::atoi(argv[2]) : 10000);
+        return 0;
+    }
+#endif
+
+    if (argc > 1 && std::string(argv[1]) == "--teardown")
+    {
+        run_teardown_benchmark(argc > 2 ? std::atoi(argv[2]) : 1000000);
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--naming-map")
+    {
+        for (int block_count : {1000, 10000, 100000})
+        {
+            run_naming_map_benchmark<int>("hashed", block_count);
+            run_naming_map_benchmark<unhashable_key>("ordered", block_count);
+        }
+        return 0;
+    }
+
+#ifdef DOM_HEAP_TRACKING
+    if (argc > 1 && std::string(argv[1]) == "--list-edits")
+    {
+        run_list_edit_benchmark(argc > 2 ? std::atoi(argv[2]) : 10000);
+        return 0;
+    }
+#else
+    if (argc > 1
+        && (std::string(argv[1]) == "--for-each"
+            || std::string(argv[1]) == "--list-edits"))
+    {
+        std::cerr << argv[1] << " reports heap usage, so it requires "
+                  << "main-headless-heap." << std::endl;
+        return 1;
+    }
+#endif
+
+    if (argc > 1 && std::string(argv[1]) == "--multi-root")
+    {
+        run_multi_root(argc > 2 ? std::atoi(argv[2]) : 1000);
+        return 0;
+    }
+
+    int refresh_count = argc > 1 ? std::atoi(argv[1]) : 1000;
+
+    // Set up the equivalent of the relevant parts of index.html.
+    mount_placeholder(document, buffer, "content-root");
 
     static alia::system content_sys;
     static dom::system content_dom;
     initialize(content_dom, content_sys, "content-root", do_content_ui);
 
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i != refresh_count; ++i)
+        refresh_system(content_sys);
+    auto end = std::chrono::steady_clock::now();
+
+    write_html(std::cout, document.body());
+    std::cout << std::endl;
+
+    auto total_us
+        = std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+              .count();
+    std::cout << refresh_count << " refreshes: " << total_us << " us ("
+              << (refresh_count != 0 ? double(total_us) / refresh_count : 0)
+              << " us/refresh), " << document.node_count() << " nodes"
+              << std::endl;
+
+    auto const& mutations = content_dom.last_refresh_mutations;
+    std::cout << "last refresh: " << mutations.created_elements
+              << " elements created, " << mutations.created_text_nodes
+              << " text nodes created, " << mutations.insertions
+              << " insertions, " << mutations.removals << " removals, "
+              << mutations.attribute_sets + mutations.attribute_removals
+              << " attribute changes, "
+              << mutations.property_sets + mutations.property_removals
+              << " property changes, " << mutations.node_value_sets
+              << " node values set, " << mutations.string_bytes
+              << " string bytes" << std::endl;
+
     return 0;
 };
+
+#else
+
+int
+main()
+{
+    // All roots are mounted in one host so that they refresh (and flush)
+    // together.
+    static multi_root_host host;
+    // host.mount("nav-root", do_nav_ui);
+    host.mount("content-root", do_content_ui);
+
+    return 0;
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include "multi_root_host.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace dom {
+
+namespace {
+
+// the external interface for systems that are mounted in a host
+struct host_external_interface : alia::default_external_interface
+{
+    host_external_interface(multi_root_host& host, host_root& root)
+        : default_external_interface(root.alia_system), host(host), root(root)
+    {
+    }
+
+    void
+    schedule_animation_refresh()
+    {
+        host.request_refresh(root, true);
+    }
+
+    void
+    schedule_timer_event(
+        external_component_id component, millisecond_count time)
+    {
+        schedule_system_timer_event(this->owner, component, time);
+        host.arm_timeout();
+    }
+
+    void
+    request_refresh()
+    {
+        host.request_refresh(root);
+    }
+
+    multi_root_host& host;
+    host_root& root;
+};
+
+double
+get_time_in_ms()
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
+multi_root_host::multi_root_host()
+    : self_(std::make_shared<multi_root_host*>(this))
+{
+}
+
+multi_root_host::~multi_root_host()
+{
+    *self_ = nullptr;
+    if (timeout_armed)
+        clear_host_timeout(*this);
+    // Destroy the roots in reverse order of mounting.
+    while (!roots_.empty())
+        roots_.pop_back();
+}
+
+host_root&
+multi_root_host::mount(
+    std::string const& dom_node_id,
+    std::function<void(dom::context)> controller,
+    bool hydrate)
+{
+    roots_.emplace_back(new host_root);
+    host_root& root = *roots_.back();
+    root.dom_node_id = dom_node_id;
+    initialize_system(
+        root.alia_system,
+        std::ref(root.dom_system),
+        new host_external_interface(*this, root));
+    root.dom_system.controller = std::move(controller);
+    root.dom_system.flush_after_traversal = false;
+    attach_system(root.dom_system, root.alia_system, dom_node_id, hydrate);
+    return root;
+}
+
+void
+multi_root_host::request_refresh(host_root& root, bool animation)
+{
+    root.dirty = true;
+    // Requests that come in during a tick or while issuing a batch of timer
+    // events are picked up when that finishes.
+    if (ticking_ || issuing_timer_events_)
+        return;
+    if (has_frame_clock())
+        schedule_tick();
+    else if (!animation)
+        tick();
+}
+
+void
+multi_root_host::schedule_tick()
+{
+    if (tick_requested_)
+        return;
+    tick_requested_ = true;
+    auto self = self_;
+    schedule_frame_task([self]() {
+        if (*self)
+            (*self)->tick();
+    });
+}
+
+bool
+multi_root_host::needs_tick() const
+{
+    return std::any_of(roots_.begin(), roots_.end(), [](auto const& root) {
+        return root->dirty;
+    });
+}
+
+void
+multi_root_host::tick()
+{
+    tick_requested_ = false;
+    if (!needs_tick() && get_command_buffer().words.empty())
+        return;
+
+    ticking_ = true;
+    for (auto& root : roots_)
+    {
+        if (!root->dirty)
+            continue;
+        // Clear this first, since refreshing can request another refresh
+        // (e.g., for animations), and that belongs to the next tick.
+        root->dirty = false;
+        double start = get_time_in_ms();
+        refresh_system(root->alia_system);
+        double elapsed = get_time_in_ms() - start;
+        auto& stats = root->stats;
+        ++stats.refreshes;
+        stats.last_refresh_time = elapsed;
+        stats.max_refresh_time = (std::max)(stats.max_refresh_time, elapsed);
+        stats.total_refresh_time += elapsed;
+    }
+    ticking_ = false;
+
+    double start = get_time_in_ms();
+    flush_commands();
+    double elapsed = get_time_in_ms() - start;
+    ++stats_.ticks;
+    stats_.last_flush_time = elapsed;
+    stats_.max_flush_time = (std::max)(stats_.max_flush_time, elapsed);
+
+    // Anything that was requested during the tick goes in the next frame.
+    if (needs_tick() && has_frame_clock())
+        schedule_tick();
+}
+
+void
+multi_root_host::arm_timeout()
+{
+    auto now = get_tick_count();
+    bool any = false;
+    millisecond_count deadline = 0;
+    for (auto const& root : roots_)
+    {
+        auto& scheduler = root->alia_system.scheduler;
+        if (!has_scheduled_events(scheduler))
+            continue;
+        auto root_deadline = now + get_time_until_next_event(scheduler, now);
+        if (!any || int(root_deadline - deadline) < 0)
+            deadline = root_deadline;
+        any = true;
+    }
+    if (!any)
+        return;
+    // If the current timeout will fire soon enough, leave it alone.
+    if (timeout_armed)
+    {
+        if (int(deadline - timeout_deadline) >= 0)
+            return;
+        clear_host_timeout(*this);
+    }
+    timeout_armed = true;
+    timeout_deadline = deadline;
+    set_host_timeout(*this, deadline - now);
+}
+
+void
+multi_root_host::issue_timer_events(millisecond_count now)
+{
+    timeout_armed = false;
+    issuing_timer_events_ = true;
+    // Issue the events in deadline order across all the roots (rather than
+    // root by root). Issuing a root's events as of a particular deadline only
+    // issues the ones that are due by then, so do that for each deadline in
+    // turn.
+    std::vector<std::pair<millisecond_count, host_root*>> deadlines;
+    for (auto& root : roots_)
+    {
+        for (auto const& request : root->alia_system.scheduler.requests)
+        {
+            if (int(now - request.trigger_time) >= 0)
+                deadlines.emplace_back(request.trigger_time, root.get());
+        }
+    }
+    std::stable_sort(
+        deadlines.begin(), deadlines.end(), [&](auto const& a, auto const& b) {
+            return int(a.first - now) < int(b.first - now);
+        });
+    for (auto const& deadline : deadlines)
+        issue_due_timer_events(deadline.second->alia_system, deadline.first);
+    issuing_timer_events_ = false;
+    if (needs_tick())
+    {
+        if (has_frame_clock())
+            schedule_tick();
+        else
+            tick();
+    }
+    arm_timeout();
+}
+
+millisecond_count
+multi_root_host::get_tick_count() const
+{
+    // All the roots share the same clock.
+    return roots_.empty()
+               ? 0
+               : roots_.front()->alia_system.external->get_tick_count();
+}
+
+} // namespace dom
@@ -0,0 +1,147 @@
+#ifndef MULTI_ROOT_HOST_HPP
+#define MULTI_ROOT_HOST_HPP
+
+#include "dom.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// This file provides a host for pages that mount several independent systems
+// (e.g., a navigation bar and a content panel, each at its own element).
+//
+// Systems that are initialized separately each schedule their own refreshes
+// and timers and flush their own DOM mutations, so several of them changing
+// at once can cost several layouts per frame. The systems mounted in a
+// multi_root_host instead share a single tick: the host refreshes every
+// system that needs it and then flushes all of their mutations together. They
+// also share a single timer deadline.
+//
+// When there's a frame_clock (which the emscripten backend always installs),
+// ticks are run at the start of the next frame (as frame tasks). Without one,
+// a tick is run as soon as an event or timer needs it, and animation refreshes
+// are left to whoever is driving things (see needs_tick()).
+
+namespace dom {
+
+// timing statistics for a single root (in milliseconds)
+struct host_root_stats
+{
+    std::uint64_t refreshes = 0;
+    double last_refresh_time = 0;
+    double max_refresh_time = 0;
+    double total_refresh_time = 0;
+};
+
+struct host_root
+{
+    // the ID of the element that the root was mounted at
+    std::string dom_node_id;
+
+    // (The alia::system refers to the dom::system, so it has to come second
+    // so that it's destroyed first.)
+    dom::system dom_system;
+    alia::system alia_system;
+
+    // Does this root need to be refreshed at the next tick?
+    bool dirty = false;
+
+    host_root_stats stats;
+};
+
+struct multi_root_host_stats
+{
+    // the number of ticks that were run
+    std::uint64_t ticks = 0;
+    // the time spent flushing the combined mutations (in milliseconds)
+    double last_flush_time = 0;
+    double max_flush_time = 0;
+};
+
+struct multi_root_host
+{
+    multi_root_host();
+    ~multi_root_host();
+
+    // Mount :controller at the element with the given ID. (This is the
+    // equivalent of initialize() for a single system.)
+    host_root&
+    mount(
+        std::string const& dom_node_id,
+        std::function<void(dom::context)> controller,
+        bool hydrate = false);
+
+    std::vector<std::unique_ptr<host_root>> const&
+    roots() const
+    {
+        return roots_;
+    }
+
+    multi_root_host_stats const&
+    stats() const
+    {
+        return stats_;
+    }
+
+    // Mark a root as needing a refresh. Unless :animation is set (in which
+    // case the refresh is left for the next frame), this also arranges for a
+    // tick to happen.
+    void
+    request_refresh(host_root& root, bool animation = false);
+
+    // Is any root waiting for a tick?
+    bool
+    needs_tick() const;
+
+    // Refresh all the roots that need it and then flush the command buffer.
+    void
+    tick();
+
+    // Arm the shared timer for the earliest timer event that any root has
+    // scheduled (if it's not already armed for something earlier).
+    void
+    arm_timeout();
+
+    // Issue all the timer events that are due (as of :now) across all roots
+    // (in order of their deadlines) and then do a single tick for all of them.
+    void
+    issue_timer_events(millisecond_count now);
+
+    // the current tick count (as the roots see it)
+    millisecond_count
+    get_tick_count() const;
+
+    // the state of the shared timer
+    // (timeout_id is reserved for the backend.)
+    bool timeout_armed = false;
+    millisecond_count timeout_deadline = 0;
+    int timeout_id = 0;
+
+ private:
+    // Schedule a tick as a frame task (if one isn't already scheduled).
+    void
+    schedule_tick();
+
+    std::vector<std::unique_ptr<host_root>> roots_;
+    multi_root_host_stats stats_;
+    bool tick_requested_ = false;
+    bool ticking_ = false;
+    bool issuing_timer_events_ = false;
+    // This is shared with any pending frame task so that the task can tell if
+    // the host has been destroyed.
+    std::shared_ptr<multi_root_host*> self_;
+};
+
+// The backends implement these to provide the shared timer. When the timer
+// fires, the backend calls issue_timer_events() on the host.
+// (The headless backend doesn't have real timers, so whoever is driving it is
+// responsible for checking timeout_deadline.)
+void
+set_host_timeout(multi_root_host& host, millisecond_count delay);
+void
+clear_host_timeout(multi_root_host& host);
+
+} // namespace dom
+
+#endif
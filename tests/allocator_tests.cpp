@@ -0,0 +1,84 @@
+#include "alia.hpp"
+
+#include "testing.hpp"
+
+#include <vector>
+
+using namespace alia;
+using namespace dom_tests;
+
+namespace {
+
+// Do a traversal of :graph with a list of :count named blocks, with IDs
+// starting at :first_id.
+void
+traverse_block_list(data_graph& graph, int first_id, int count)
+{
+    data_traversal traversal;
+    scoped_data_traversal scoped(graph, traversal);
+    naming_context nc(traversal);
+    for (int i = 0; i != count; ++i)
+    {
+        named_block nb(nc, make_id(first_id + i));
+        get_data<int>(traversal) = i;
+        get_data<double>(traversal) = i;
+    }
+}
+
+} // namespace
+
+TEST_CASE(allocator, freed_slots_are_reused)
+{
+    data_node_allocator allocator;
+    std::vector<void*> slots;
+    for (int i = 0; i != 1000; ++i)
+        slots.push_back(allocator.allocate(24));
+    CHECK(allocator.live_node_count == 1000);
+    std::size_t slab_count = allocator.slab_count;
+    CHECK(slab_count > 1);
+
+    // Freeing and allocating again reuses the same memory (most recently freed
+    // first), so no more slabs are needed.
+    for (void* slot : slots)
+        data_node_allocator::deallocate(slot, 24);
+    CHECK(allocator.live_node_count == 0);
+    for (int i = 0; i != 1000; ++i)
+    {
+        void* slot = allocator.allocate(24);
+        CHECK(slot == slots[999 - i]);
+    }
+    CHECK(allocator.slab_count == slab_count);
+
+    // Slots are shared by sizes within the same size class.
+    data_node_allocator::deallocate(slots[0], 24);
+    CHECK(allocator.allocate(32) == slots[0]);
+    CHECK(allocator.slab_count == slab_count);
+
+    for (void* slot : slots)
+        data_node_allocator::deallocate(slot, 24);
+    CHECK(allocator.live_node_count == 0);
+}
+
+TEST_CASE(allocator, churn_is_bounded)
+{
+    data_graph graph;
+
+    // Each pass replaces every block in the list with a new one. Since the
+    // old blocks are only freed at the end of a pass, two passes' worth of
+    // blocks are live at the peak, and after that, the memory is reused.
+    traverse_block_list(graph, 0, 1000);
+    traverse_block_list(graph, 1000, 1000);
+    std::size_t slab_count = graph.node_allocator.slab_count;
+    std::size_t live_node_count = graph.node_allocator.live_node_count;
+    for (int pass = 2; pass != 100; ++pass)
+        traverse_block_list(graph, pass * 1000, 1000);
+    CHECK(graph.node_allocator.slab_count == slab_count);
+    CHECK(graph.node_allocator.live_node_count == live_node_count);
+
+    // The same goes for a list that grows and shrinks.
+    for (int pass = 0; pass != 100; ++pass)
+        traverse_block_list(graph, 0, pass % 2 == 0 ? 1000 : 10);
+    CHECK(graph.node_allocator.slab_count == slab_count);
+
+    traverse_block_list(graph, 0, 0);
+}
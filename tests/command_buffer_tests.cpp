@@ -0,0 +1,196 @@
+#include "command_buffer.hpp"
+#include "event_latency.hpp"
+#include "testing.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace dom;
+using namespace dom_tests;
+
+namespace {
+
+// While this exists, the global command buffer's contents are captured (as
+// raw words) instead of being executed.
+struct scoped_command_capture
+{
+    scoped_command_capture()
+    {
+        command_buffer& buffer = get_command_buffer();
+        flush_commands(buffer);
+        old_executor_ = buffer.executor;
+        buffer.executor = [this](std::uint32_t const* words, std::size_t size) {
+            this->words.insert(this->words.end(), words, words + size);
+        };
+    }
+    ~scoped_command_capture()
+    {
+        command_buffer& buffer = get_command_buffer();
+        flush_commands(buffer);
+        buffer.executor = old_executor_;
+    }
+
+    std::vector<std::uint32_t> words;
+
+ private:
+    std::function<void(std::uint32_t const* words, std::size_t size)>
+        old_executor_;
+};
+
+} // namespace
+
+TEST_CASE(command_buffer, round_trip)
+{
+    scoped_command_capture capture;
+    command_buffer& buffer = get_command_buffer();
+
+    // All the names here are new, so they're defined within the captured
+    // stream. (The decoder asserts that names are defined before they're
+    // used.)
+    int tag = intern_name("round-trip-tag");
+    int name = intern_name("round-trip-name");
+    int unit = intern_name("round-trip-unit");
+    int event = intern_name("round-trip-event");
+
+    int parent = allocate_node_id();
+    int child = allocate_node_id();
+    int text = allocate_node_id();
+    int grandchild = allocate_node_id();
+    int clone = allocate_node_id();
+
+    encode_create_element(buffer, parent, tag);
+    encode_create_element(buffer, child, tag);
+    // Strings are padded to a word boundary, so cover each possible amount
+    // of padding (and an empty string and some multi-byte UTF-8).
+    encode_create_text_node(buffer, text, "");
+    encode_set_node_value(buffer, text, "a");
+    encode_set_node_value(buffer, text, "abc");
+    encode_set_node_value(buffer, text, "abcd");
+    encode_set_node_value(buffer, text, "abcde");
+    encode_set_node_value(buffer, text, "\xc3\xa9t\xc3\xa9");
+    encode_insert_before(buffer, parent, child, 0);
+    encode_insert_before(buffer, parent, text, child);
+    encode_set_attribute(buffer, child, name, "value");
+    encode_remove_attribute(buffer, child, name);
+    encode_set_node_number(buffer, text, 1234.5, 2, true);
+    encode_set_node_number(buffer, text, -0.25, -1, false);
+    encode_set_string_property(buffer, child, name, "string");
+    encode_set_number_property(buffer, child, name, 2.5);
+    encode_set_boolean_property(buffer, child, name, true);
+    encode_remove_property(buffer, child, name);
+    encode_delegate_events(buffer, parent, event);
+    encode_set_style(buffer, child, name, "red");
+    encode_set_style_number(buffer, child, name, 1.5, unit);
+    encode_set_style_color(buffer, child, name, 255, 128, 0);
+    encode_remove_style(buffer, child, name);
+    encode_add_class(buffer, child, name);
+    encode_remove_class(buffer, child, name);
+    encode_define_template(buffer, 7, "<p>template</p>");
+    encode_clone_template(buffer, clone, 7);
+    encode_begin_hydration(buffer, parent);
+    encode_end_hydration(buffer, parent);
+    encode_configure_node_pool(buffer, 64);
+    encode_detach_node(buffer, child);
+    encode_remove_child(buffer, clone);
+    // A removal whose parent is also being removed is resolved to a
+    // RELEASE_NODE.
+    queue_node_removal(buffer, grandchild, child);
+    queue_node_removal(buffer, child, 0);
+    flush_commands(buffer);
+
+    command_recorder recorder;
+    decode_commands(capture.words.data(), capture.words.size(), recorder);
+
+    CHECK(recorder.names.size() > std::size_t(event));
+    if (recorder.names.size() > std::size_t(event))
+    {
+        CHECK(recorder.names[tag] == "round-trip-tag");
+        CHECK(recorder.names[name] == "round-trip-name");
+        CHECK(recorder.names[unit] == "round-trip-unit");
+        CHECK(recorder.names[event] == "round-trip-event");
+    }
+
+    auto n = [](int id) { return std::to_string(id); };
+    std::vector<std::string> expected = {
+        "create_element " + n(parent) + " round-trip-tag",
+        "create_element " + n(child) + " round-trip-tag",
+        "create_text_node " + n(text) + " ",
+        "set_node_value " + n(text) + " a",
+        "set_node_value " + n(text) + " abc",
+        "set_node_value " + n(text) + " abcd",
+        "set_node_value " + n(text) + " abcde",
+        "set_node_value " + n(text) + " \xc3\xa9t\xc3\xa9",
+        "insert_before " + n(parent) + " " + n(child) + " 0",
+        "insert_before " + n(parent) + " " + n(text) + " " + n(child),
+        "set_attribute " + n(child) + " round-trip-name value",
+        "remove_attribute " + n(child) + " round-trip-name",
+        "set_node_value " + n(text) + " 1,234.50",
+        "set_node_value " + n(text) + " -0.25",
+        "set_string_property " + n(child) + " round-trip-name string",
+        "set_number_property " + n(child) + " round-trip-name 2.500000",
+        "set_boolean_property " + n(child) + " round-trip-name true",
+        "remove_property " + n(child) + " round-trip-name",
+        "delegate_events " + n(parent) + " round-trip-event",
+        "set_style " + n(child) + " round-trip-name red",
+        "set_style " + n(child) + " round-trip-name 1.5round-trip-unit",
+        "set_style " + n(child) + " round-trip-name rgb(255, 128, 0)",
+        "remove_style " + n(child) + " round-trip-name",
+        "add_class " + n(child) + " round-trip-name",
+        "remove_class " + n(child) + " round-trip-name",
+        "define_template 7 <p>template</p>",
+        "clone_template " + n(clone) + " 7",
+        "begin_hydration " + n(parent),
+        "end_hydration " + n(parent),
+        "configure_node_pool 64",
+        "detach_node " + n(child),
+        "remove_child " + n(clone),
+        "remove_child " + n(child),
+        "release_node " + n(grandchild),
+    };
+    CHECK(recorder.log == expected);
+    if (recorder.log != expected)
+    {
+        for (auto const& line : recorder.log)
+            std::printf("  %s\n", line.c_str());
+    }
+}
+
+TEST_CASE(command_buffer, names_are_defined_once)
+{
+    scoped_command_capture capture;
+    int first = intern_name("defined-once");
+    int second = intern_name("defined-once");
+    CHECK(first == second);
+    flush_commands();
+
+    // The stream should hold exactly one DEFINE_NAME: the opcode, the ID and
+    // the string ("defined-once" is 12 bytes, plus a null terminator, padded
+    // to 16).
+    CHECK(capture.words.size() == 3 + 4);
+    if (capture.words.size() >= 3)
+    {
+        CHECK(capture.words[0] == std::uint32_t(command_code::DEFINE_NAME));
+        CHECK(capture.words[1] == std::uint32_t(first));
+        CHECK(capture.words[2] == 12);
+    }
+}
+
+TEST_CASE(command_buffer, lookups_dont_intern)
+{
+    scoped_command_capture capture;
+    CHECK(find_interned_name("never-interned") == -1);
+    CHECK(get_event_latency_record("never-dispatched") == nullptr);
+    CHECK(find_interned_name("never-dispatched") == -1);
+
+    int id = intern_name("now-interned");
+    CHECK(find_interned_name("now-interned") == id);
+    flush_commands();
+
+    // Only the intern_name() call should have encoded anything.
+    CHECK(
+        !capture.words.empty()
+        && capture.words[0] == std::uint32_t(command_code::DEFINE_NAME)
+        && capture.words[1] == std::uint32_t(id));
+    CHECK(capture.words.size() == 3 + 4);
+}
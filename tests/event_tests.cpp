@@ -0,0 +1,140 @@
+#include "alia.hpp"
+
+#include "dom.hpp"
+#include "frame_scheduler.hpp"
+#include "testing.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace alia;
+using namespace dom;
+using namespace dom_tests;
+
+namespace {
+
+// This installs a manual clock (which enables event coalescing) for the
+// duration of a test.
+struct scoped_manual_clock
+{
+    scoped_manual_clock()
+    {
+        set_frame_clock(&clock);
+    }
+    ~scoped_manual_clock()
+    {
+        set_frame_clock(nullptr);
+    }
+
+    manual_frame_clock clock;
+};
+
+std::vector<std::string> delivered_values;
+
+void
+do_coalesced_input_ui(dom::context ctx)
+{
+    element(ctx, "input")
+        .callback(
+            "input",
+            [](js_value& e) {
+                delivered_values.push_back(
+                    e["target"]["value"].as<std::string>());
+            },
+            event_coalescing::LATEST);
+}
+
+std::vector<std::string> clicked_values;
+
+void
+do_form_ui(dom::context ctx)
+{
+    auto value = get_state(ctx, string());
+    input(ctx, value);
+    button(ctx, "go", lambda_action([&]() {
+               clicked_values.push_back(
+                   signal_has_value(value) ? read_signal(value) : "");
+           }));
+}
+
+void
+send_input(headless_node& input, std::string const& value)
+{
+    input.properties.set("value", value);
+    get_headless_document().dispatch_event(
+        input, "input", headless_value::object());
+}
+
+} // namespace
+
+TEST_CASE(events, latest_events_collapse)
+{
+    headless_document& document = get_headless_document();
+    command_buffer& buffer = get_command_buffer();
+    mount_placeholder(document, buffer, "collapse-root");
+
+    scoped_manual_clock clock;
+    dom::system dom_system;
+    alia::system alia_system;
+    initialize(dom_system, alia_system, "collapse-root", do_coalesced_input_ui);
+    headless_node& input
+        = *document.get_node(dom_system.root_node.object.js_id)->first_child;
+
+    delivered_values.clear();
+    for (char c : std::string("hello"))
+        send_input(input, std::string(1, c));
+    // Nothing is delivered until the frame, and then only the latest event
+    // is.
+    CHECK(delivered_values.empty());
+    clock.clock.advance(16);
+    CHECK(delivered_values == std::vector<std::string>{"o"});
+
+    // Each frame gets its own delivery.
+    send_input(input, "a");
+    send_input(input, "b");
+    clock.clock.advance(16);
+    send_input(input, "c");
+    clock.clock.advance(16);
+    CHECK((delivered_values == std::vector<std::string>{"o", "b", "c"}));
+
+    // With nothing held, nothing more is delivered.
+    clock.clock.advance(16);
+    CHECK(delivered_values.size() == 3);
+}
+
+TEST_CASE(events, held_events_precede_immediate_ones)
+{
+    headless_document& document = get_headless_document();
+    command_buffer& buffer = get_command_buffer();
+    mount_placeholder(document, buffer, "form-root");
+
+    scoped_manual_clock clock;
+    dom::system dom_system;
+    alia::system alia_system;
+    initialize(dom_system, alia_system, "form-root", do_form_ui);
+    headless_node* root = document.get_node(dom_system.root_node.object.js_id);
+    CHECK(root && root->first_child && root->first_child->next_sibling);
+    if (!root || !root->first_child || !root->first_child->next_sibling)
+        return;
+    headless_node& input = *root->first_child;
+    headless_node& button = *input.next_sibling;
+
+    // Type into the input and click the button, all within one frame. The
+    // 'input' events are still being held when the click arrives, but the
+    // click handler must see their effect.
+    clicked_values.clear();
+    std::string typed;
+    for (char c : std::string("hello"))
+    {
+        typed += c;
+        send_input(input, typed);
+    }
+    document.dispatch_event(button, "click", headless_value::object());
+    CHECK(clicked_values == std::vector<std::string>{"hello"});
+
+    // The held events were delivered, so the frame has nothing to do with
+    // them.
+    clock.clock.advance(16);
+    document.dispatch_event(button, "click", headless_value::object());
+    CHECK((clicked_values == std::vector<std::string>{"hello", "hello"}));
+}
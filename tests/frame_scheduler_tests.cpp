@@ -0,0 +1,149 @@
+#include "alia.hpp"
+
+#include "frame_scheduler.hpp"
+#include "testing.hpp"
+
+using namespace alia;
+using namespace dom;
+using namespace dom_tests;
+
+namespace {
+
+// This installs a manual clock and enables frame scheduling for the duration
+// of a test (and restores the defaults afterwards).
+struct scoped_frame_scheduling
+{
+    scoped_frame_scheduling()
+    {
+        set_frame_clock(&clock);
+        enable_frame_scheduling(true);
+        reset_frame_scheduler_stats();
+    }
+    ~scoped_frame_scheduling()
+    {
+        enable_frame_scheduling(false);
+        set_frame_clock(nullptr);
+        set_frame_budget(8);
+        reset_frame_scheduler_stats();
+    }
+
+    manual_frame_clock clock;
+};
+
+// a system whose refreshes are counted and (optionally) take a fixed amount
+// of (clock) time
+struct test_system
+{
+    test_system(manual_frame_clock& clock, double refresh_cost = 0)
+    {
+        initialize_system(
+            sys,
+            [this, &clock, refresh_cost](context ctx) {
+                if (is_refresh_event(ctx))
+                {
+                    ++refresh_count;
+                    clock.time += refresh_cost;
+                }
+            },
+            new frame_scheduled_external_interface(sys));
+        // Get the initial refresh out of the way.
+        refresh_system(sys);
+        refresh_count = 0;
+    }
+
+    alia::system sys;
+    int refresh_count = 0;
+};
+
+} // namespace
+
+TEST_CASE(frame_scheduler, one_refresh_per_frame)
+{
+    scoped_frame_scheduling scheduling;
+    test_system system(scheduling.clock);
+
+    for (int i = 0; i != 100; ++i)
+        request_refresh(system.sys);
+    // Nothing happens until the frame.
+    CHECK(system.refresh_count == 0);
+    CHECK(scheduling.clock.frame_requested);
+
+    scheduling.clock.advance(16);
+    CHECK(system.refresh_count == 1);
+
+    // With nothing dirty, no further frames are requested.
+    CHECK(!scheduling.clock.frame_requested);
+    scheduling.clock.advance(16);
+    CHECK(system.refresh_count == 1);
+
+    // Dirtying it again gets exactly one more refresh.
+    request_refresh(system.sys);
+    request_refresh(system.sys);
+    scheduling.clock.advance(16);
+    CHECK(system.refresh_count == 2);
+
+    auto const& stats = get_frame_scheduler_stats();
+    CHECK(stats.requests == 102);
+    CHECK(stats.merged == 100);
+    CHECK(stats.frames == 2);
+    CHECK(stats.refreshes == 2);
+    CHECK(stats.deferred == 0);
+}
+
+TEST_CASE(frame_scheduler, budget_overrun_defers)
+{
+    scoped_frame_scheduling scheduling;
+    set_frame_budget(8);
+    test_system a(scheduling.clock, 5), b(scheduling.clock, 5),
+        c(scheduling.clock, 5);
+
+    request_refresh(a.sys);
+    request_refresh(b.sys);
+    request_refresh(c.sys);
+
+    // a and b fit within the budget (since it's only checked between
+    // refreshes), but by then, the frame is over budget, so c is deferred.
+    scheduling.clock.advance(16);
+    CHECK(a.refresh_count == 1);
+    CHECK(b.refresh_count == 1);
+    CHECK(c.refresh_count == 0);
+    CHECK(scheduling.clock.frame_requested);
+
+    auto const& stats = get_frame_scheduler_stats();
+    CHECK(stats.deferred == 1);
+    CHECK(stats.last_frame_time == 10);
+
+    // The deferred system goes first in the next frame, even if others were
+    // requested in the meantime.
+    request_refresh(a.sys);
+    scheduling.clock.advance(16);
+    CHECK(c.refresh_count == 1);
+    CHECK(a.refresh_count == 2);
+    CHECK(stats.frames == 2);
+    CHECK(stats.refreshes == 4);
+    CHECK(!scheduling.clock.frame_requested);
+}
+
+TEST_CASE(frame_scheduler, at_least_one_refresh_per_frame)
+{
+    scoped_frame_scheduling scheduling;
+    set_frame_budget(1);
+    test_system a(scheduling.clock, 5), b(scheduling.clock, 5);
+
+    request_refresh(a.sys);
+    request_refresh(b.sys);
+    request_refresh(a.sys);
+
+    scheduling.clock.advance(16);
+    CHECK(a.refresh_count == 1);
+    CHECK(b.refresh_count == 0);
+    scheduling.clock.advance(16);
+    CHECK(b.refresh_count == 1);
+
+    auto const& stats = get_frame_scheduler_stats();
+    CHECK(stats.requests == 3);
+    CHECK(stats.merged == 1);
+    CHECK(stats.deferred == 1);
+    CHECK(stats.frames == 2);
+    CHECK(stats.max_frame_time == 5);
+}
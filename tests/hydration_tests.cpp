@@ -0,0 +1,99 @@
+#include "alia.hpp"
+
+#include "dom.hpp"
+#include "testing.hpp"
+
+#include <string>
+
+using namespace alia;
+using namespace dom;
+using namespace dom_tests;
+
+namespace {
+
+std::string heading = "hello";
+
+void
+do_page_ui(dom::context ctx)
+{
+    element(ctx, "div").attr("class", "page").children([&](auto ctx) {
+        element(ctx, "h1").text(value(heading));
+        element(ctx, "p")
+            .attr("title", "note")
+            .class_if("big", true)
+            .style("color", "red")
+            .text("text");
+    });
+}
+
+// Replace the first occurrence of :from in :text with :to.
+bool
+replace(std::string& text, std::string const& from, std::string const& to)
+{
+    auto position = text.find(from);
+    if (position == std::string::npos)
+        return false;
+    text.replace(position, from.size(), to);
+    return true;
+}
+
+} // namespace
+
+TEST_CASE(hydration, server_content_is_adopted)
+{
+    headless_document& document = get_headless_document();
+    command_buffer& buffer = get_command_buffer();
+
+    heading = "hello";
+    std::string html = render_to_html(do_page_ui);
+
+    // Give the server's markup an attribute that the client doesn't set and
+    // an element that the client doesn't have.
+    CHECK(replace(html, "<h1>", "<h1 data-stale=\"1\">"));
+    html += "<p>extra</p>";
+
+    mount_rendered_placeholder(document, buffer, "hydration-root", html);
+    headless_node* root = document.get_element_by_id("hydration-root");
+    CHECK(root && root->first_child && root->first_child->first_child);
+    if (!root || !root->first_child || !root->first_child->first_child)
+        return;
+    headless_node* page = root->first_child;
+    headless_node* h1 = page->first_child;
+    headless_node* p = h1->next_sibling;
+    CHECK(p && p->tag == "p");
+    std::size_t node_count = document.node_count();
+
+    dom::system dom_system;
+    alia::system alia_system;
+    initialize(dom_system, alia_system, "hydration-root", do_page_ui, true);
+
+    // The existing nodes were adopted rather than recreated.
+    CHECK(dom_system.root_node.object.js_id == root->id);
+    CHECK(root->first_child == page);
+    CHECK(page->first_child == h1);
+    CHECK(h1->next_sibling == p);
+    CHECK(h1->first_child && h1->first_child->text == "hello");
+
+    // The extra element (and its text) was dropped.
+    CHECK(!page->next_sibling);
+    CHECK(document.node_count() == node_count - 2);
+
+    // The attributes that the client sets were kept, and the stale one was
+    // removed.
+    CHECK(h1->attributes.empty());
+    std::string const* title = get_attribute(*p, "title");
+    CHECK(title && *title == "note");
+    std::string const* classes = get_attribute(*p, "class");
+    CHECK(classes && *classes == "big");
+    std::string const* style = get_attribute(*p, "style");
+    CHECK(style && *style == "color: red;");
+    std::string const* page_class = get_attribute(*page, "class");
+    CHECK(page_class && *page_class == "page");
+
+    // Later changes apply to the adopted nodes.
+    heading = "goodbye";
+    refresh_system(alia_system);
+    flush_commands(buffer);
+    CHECK(page->first_child == h1);
+    CHECK(h1->first_child && h1->first_child->text == "goodbye");
+}
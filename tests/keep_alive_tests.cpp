@@ -0,0 +1,171 @@
+#include "alia.hpp"
+
+#include "dom.hpp"
+#include "testing.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace alia;
+using namespace dom;
+using namespace dom_tests;
+
+namespace {
+
+bool show_panel = true;
+bool panel_active = true;
+
+void
+do_keep_alive_ui(dom::context ctx)
+{
+    ALIA_IF(show_panel)
+    {
+        element(ctx, "div").children([&](auto ctx) {
+            keep_alive(ctx, panel_active, [&](auto ctx) {
+                auto text = get_state(ctx, std::string("initial"));
+                input(ctx, text);
+                element(ctx, "p").text(text);
+            });
+            element(ctx, "span").text("after");
+        });
+    }
+    ALIA_END
+}
+
+std::vector<int>
+get_child_ids(headless_node const& node)
+{
+    std::vector<int> ids;
+    for (headless_node const* child = node.first_child; child;
+         child = child->next_sibling)
+    {
+        ids.push_back(child->id);
+    }
+    return ids;
+}
+
+// a keep_alive panel mounted in the headless document
+struct keep_alive_panel
+{
+    keep_alive_panel(char const* root_id)
+    {
+        headless_document& document = get_headless_document();
+        mount_placeholder(document, get_command_buffer(), root_id);
+        show_panel = false;
+        panel_active = true;
+        initialize(dom_system, alia_system, root_id, do_keep_alive_ui);
+        baseline = document.node_count();
+        show_panel = true;
+        update();
+        root = document.get_node(dom_system.root_node.object.js_id);
+    }
+
+    void
+    update()
+    {
+        refresh_system(alia_system);
+        flush_commands();
+    }
+
+    // the panel's div
+    headless_node*
+    div()
+    {
+        return root ? root->first_child : nullptr;
+    }
+
+    dom::system dom_system;
+    alia::system alia_system;
+    std::size_t baseline = 0;
+    headless_node* root = nullptr;
+};
+
+} // namespace
+
+TEST_CASE(keep_alive, deactivation_detaches)
+{
+    headless_document& document = get_headless_document();
+    keep_alive_panel panel("keep-alive-detach-root");
+    CHECK(panel.div());
+    if (!panel.div())
+        return;
+    std::vector<int> ids = get_child_ids(*panel.div());
+    CHECK(ids.size() == 3);
+    std::size_t node_count = document.node_count();
+
+    scoped_command_recording recording;
+    panel_active = false;
+    panel.update();
+
+    // The input and the p are detached, but nothing is destroyed.
+    auto const& recorder = recording.recorder;
+    CHECK(recorder.count("detach_node") == 2);
+    CHECK(recorder.count("remove_child") == 0);
+    CHECK(recorder.count("release_node") == 0);
+    CHECK(document.node_count() == node_count);
+    CHECK(get_child_ids(*panel.div()) == std::vector<int>{ids[2]});
+    CHECK(document.get_node(ids[0]) && !document.get_node(ids[0])->parent);
+}
+
+TEST_CASE(keep_alive, reactivation_restores)
+{
+    headless_document& document = get_headless_document();
+    keep_alive_panel panel("keep-alive-restore-root");
+    CHECK(panel.div());
+    if (!panel.div())
+        return;
+    std::vector<int> ids = get_child_ids(*panel.div());
+
+    // Change the content's state.
+    headless_node& input = *document.get_node(ids[0]);
+    input.properties.set("value", "edited");
+    document.dispatch_event(input, "input", headless_value::object());
+    flush_commands();
+    headless_node& p = *document.get_node(ids[1]);
+    CHECK(p.first_child && p.first_child->text == "edited");
+
+    panel_active = false;
+    panel.update();
+
+    scoped_command_recording recording;
+    panel_active = true;
+    panel.update();
+
+    // The same nodes are put back (in the same place), with their state.
+    auto const& recorder = recording.recorder;
+    CHECK(recorder.count("create_element") == 0);
+    CHECK(recorder.count("create_text_node") == 0);
+    CHECK(recorder.count("insert_before") == 2);
+    CHECK(get_child_ids(*panel.div()) == ids);
+    CHECK(document.get_node(ids[1]) == &p);
+    CHECK(p.first_child && p.first_child->text == "edited");
+}
+
+TEST_CASE(keep_alive, destruction_releases_everything)
+{
+    headless_document& document = get_headless_document();
+    keep_alive_panel panel("keep-alive-destroy-root");
+    CHECK(panel.div());
+    if (!panel.div())
+        return;
+    std::vector<int> ids = get_child_ids(*panel.div());
+
+    // Destroy the panel while its content is detached.
+    panel_active = false;
+    panel.update();
+    show_panel = false;
+    panel.update();
+    CHECK(!panel.root->first_child);
+    CHECK(document.node_count() == panel.baseline);
+    for (int id : ids)
+        CHECK(!document.get_node(id));
+
+    // And again while it's active.
+    panel_active = true;
+    show_panel = true;
+    panel.update();
+    CHECK(panel.div());
+    show_panel = false;
+    panel.update();
+    CHECK(document.node_count() == panel.baseline);
+}
@@ -0,0 +1,179 @@
+#include "alia.hpp"
+
+#include "dom.hpp"
+#include "testing.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace alia;
+using namespace dom;
+using namespace dom_tests;
+
+namespace {
+
+std::vector<int> row_ids;
+
+void
+do_keyed_list_ui(dom::context ctx)
+{
+    element(ctx, "ul").keyed_children([&](auto ctx) {
+        naming_context nc(ctx);
+        for (int id : row_ids)
+        {
+            named_block nb(nc, make_id(id));
+            element(ctx, "li").text(std::to_string(id));
+        }
+    });
+}
+
+// a keyed list (of the rows in :row_ids) mounted in the headless document
+struct keyed_list
+{
+    keyed_list(char const* root_id)
+    {
+        mount_placeholder(
+            get_headless_document(), get_command_buffer(), root_id);
+        initialize(dom_system, alia_system, root_id, do_keyed_list_ui);
+        flush_commands();
+    }
+
+    // Show :ids and return the mutations that that took.
+    mutation_counts
+    show(std::vector<int> const& ids)
+    {
+        row_ids = ids;
+        refresh_system(alia_system);
+        flush_commands();
+        return dom_system.last_refresh_mutations;
+    }
+
+    // Check that the DOM shows :row_ids (in order).
+    bool
+    matches_rows()
+    {
+        headless_node* root = get_headless_document().get_node(
+            dom_system.root_node.object.js_id);
+        if (!root || !root->first_child)
+            return false;
+        std::vector<int> shown;
+        for (headless_node* li = root->first_child->first_child; li;
+             li = li->next_sibling)
+        {
+            shown.push_back(
+                li->first_child ? std::stoi(li->first_child->text) : -1);
+        }
+        return shown == row_ids;
+    }
+
+    dom::system dom_system;
+    alia::system alia_system;
+};
+
+std::vector<int>
+make_rows(int n)
+{
+    std::vector<int> ids(n);
+    for (int i = 0; i != n; ++i)
+        ids[i] = i;
+    return ids;
+}
+
+} // namespace
+
+TEST_CASE(keyed_children, rotation_moves_one_row)
+{
+    keyed_list list("rotation-root");
+    std::vector<int> ids = make_rows(6);
+    list.show(ids);
+    CHECK(list.matches_rows());
+
+    std::rotate(ids.begin(), ids.begin() + 1, ids.end());
+    CHECK(list.show(ids).insertions == 1);
+    CHECK(list.matches_rows());
+
+    std::rotate(ids.rbegin(), ids.rbegin() + 1, ids.rend());
+    CHECK(list.show(ids).insertions == 1);
+    CHECK(list.matches_rows());
+}
+
+TEST_CASE(keyed_children, removal_moves_nothing)
+{
+    keyed_list list("removal-root");
+    std::vector<int> ids = make_rows(6);
+    list.show(ids);
+
+    // removal at the head
+    ids.erase(ids.begin());
+    CHECK(list.show(ids).insertions == 0);
+    CHECK(list.matches_rows());
+
+    // removal in the middle
+    ids.erase(ids.begin() + 2);
+    CHECK(list.show(ids).insertions == 0);
+    CHECK(list.matches_rows());
+
+    // removal along with a swap further along
+    ids.erase(ids.begin());
+    std::swap(ids[1], ids[2]);
+    CHECK(list.show(ids).insertions == 1);
+    CHECK(list.matches_rows());
+}
+
+TEST_CASE(keyed_children, reversal_moves_all_but_one)
+{
+    keyed_list list("reversal-root");
+    std::vector<int> ids = make_rows(10);
+    list.show(ids);
+
+    std::reverse(ids.begin(), ids.end());
+    CHECK(list.show(ids).insertions == 9);
+    CHECK(list.matches_rows());
+}
+
+TEST_CASE(keyed_children, mutation_counts)
+{
+    keyed_list list("counts-root");
+    std::vector<int> ids = make_rows(4);
+    list.show(ids);
+
+    // an insertion (of an li and its text)
+    ids.insert(ids.begin() + 2, 10);
+    mutation_counts counts = list.show(ids);
+    CHECK(counts.created_elements == 1);
+    CHECK(counts.created_text_nodes == 1);
+    CHECK(counts.insertions == 2);
+    CHECK(counts.removals == 0);
+
+    // a move
+    std::swap(ids[0], ids[1]);
+    counts = list.show(ids);
+    CHECK(counts.created_elements == 0);
+    CHECK(counts.insertions == 1);
+    CHECK(counts.removals == 0);
+
+    // a removal (which only removes the li itself from the DOM)
+    // The li's text isn't destroyed until its block is collected, but that
+    // should still be part of the same refresh (and its flush).
+    headless_document& document = get_headless_document();
+    std::size_t node_count = document.node_count();
+    ids.erase(ids.begin() + 3);
+    row_ids = ids;
+    refresh_system(list.alia_system);
+    CHECK(get_command_buffer().queued_removals.empty());
+    CHECK(document.node_count() == node_count - 2);
+    counts = list.dom_system.last_refresh_mutations;
+    CHECK(counts.insertions == 0);
+    CHECK(counts.removals == 1);
+    CHECK(counts.created_elements == 0);
+    CHECK(list.matches_rows());
+
+    // The latest refresh's counts are also available globally.
+    CHECK(get_last_refresh_mutations().removals == 1);
+
+    // Nothing should be left over for the next refresh.
+    counts = list.show(ids);
+    CHECK(counts.removals == 0);
+    CHECK(counts.insertions == 0);
+}
@@ -0,0 +1,108 @@
+#include "alia.hpp"
+
+#include "multi_root_host.hpp"
+#include "testing.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace alia;
+using namespace dom;
+using namespace dom_tests;
+
+namespace {
+
+struct timer_ui_data
+{
+    bool started = false;
+};
+
+// the names of the roots whose timers have fired, in the order that they did
+std::vector<std::string> fired_timers;
+
+// Make a UI that shows :text and starts a timer (once) that fires after
+// :delay.
+std::function<void(dom::context)>
+make_timer_ui(std::string const& name, std::string const* text, unsigned delay)
+{
+    return [=](dom::context ctx) {
+        element(ctx, "p").text(value(*text));
+        raw_timer timer(ctx);
+        if (timer.is_triggered())
+            fired_timers.push_back(name);
+        timer_ui_data* data;
+        get_cached_data(ctx, &data);
+        on_refresh(ctx, [&](auto ctx) {
+            if (!data->started)
+            {
+                timer.start(delay);
+                data->started = true;
+            }
+        });
+    };
+}
+
+std::string
+get_text(host_root const& root)
+{
+    headless_node* node = get_headless_document().get_node(
+        root.dom_system.root_node.object.js_id);
+    return node && node->first_child && node->first_child->first_child
+               ? node->first_child->first_child->text
+               : "";
+}
+
+} // namespace
+
+TEST_CASE(multi_root_host, roots_are_independent)
+{
+    headless_document& document = get_headless_document();
+    command_buffer& buffer = get_command_buffer();
+    mount_placeholder(document, buffer, "host-first-root");
+    mount_placeholder(document, buffer, "host-second-root");
+
+    std::string first_text = "a", second_text = "b";
+    fired_timers.clear();
+    {
+        multi_root_host host;
+        host_root& first = host.mount(
+            "host-first-root", make_timer_ui("first", &first_text, 300));
+        host_root& second = host.mount(
+            "host-second-root", make_timer_ui("second", &second_text, 100));
+        CHECK(get_text(first) == "a");
+        CHECK(get_text(second) == "b");
+
+        // Refreshing one root leaves the other alone.
+        auto first_refreshes = first.stats.refreshes;
+        auto second_refreshes = second.stats.refreshes;
+        first_text = "c";
+        second_text = "d";
+        host.request_refresh(first);
+        CHECK(first.stats.refreshes == first_refreshes + 1);
+        CHECK(second.stats.refreshes == second_refreshes);
+        CHECK(get_text(first) == "c");
+        CHECK(get_text(second) == "b");
+
+        host.request_refresh(second);
+        CHECK(first.stats.refreshes == first_refreshes + 1);
+        CHECK(second.stats.refreshes == second_refreshes + 1);
+        CHECK(get_text(second) == "d");
+
+        // The shared timer is armed for the earlier of the two timers.
+        CHECK(host.timeout_armed);
+        millisecond_count now = host.get_tick_count();
+        CHECK(int(host.timeout_deadline - now) <= 100);
+
+        // When both are due at once, they're still issued in deadline order
+        // (rather than in the order that the roots were mounted), and then
+        // each root is refreshed once.
+        auto ticks = host.stats().ticks;
+        host.issue_timer_events(now + 1000);
+        CHECK((fired_timers == std::vector<std::string>{"second", "first"}));
+        CHECK(host.stats().ticks == ticks + 1);
+        CHECK(first.stats.refreshes == first_refreshes + 2);
+        CHECK(second.stats.refreshes == second_refreshes + 2);
+        CHECK(!host.timeout_armed);
+    }
+    flush_commands(buffer);
+}
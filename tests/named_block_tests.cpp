@@ -0,0 +1,139 @@
+#include "alia.hpp"
+
+#include "testing.hpp"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace alia;
+using namespace dom_tests;
+
+namespace {
+
+struct interruption
+{
+};
+
+// Traverse named blocks with the given IDs (in order), storing each block's ID
+// in it. If :interrupt_after is nonnegative, the traversal is abandoned (by
+// throwing) after that many blocks. Returns true iff every block that was
+// visited either was new (and expected to be) or still held its own ID.
+bool
+traverse_blocks(
+    data_graph& graph,
+    std::vector<int> const& ids,
+    std::vector<int> const& expected_new = {},
+    int interrupt_after = -1)
+{
+    bool ok = true;
+    try
+    {
+        data_traversal traversal;
+        scoped_data_traversal scoped(graph, traversal);
+        naming_context nc(traversal);
+        int count = 0;
+        for (int id : ids)
+        {
+            if (count++ == interrupt_after)
+                throw interruption();
+            named_block nb(nc, make_id(id));
+            int* value;
+            bool is_new = get_data(traversal, &value);
+            bool expected = std::find(
+                                expected_new.begin(), expected_new.end(), id)
+                            != expected_new.end();
+            if (is_new != expected || (!is_new && *value != id))
+                ok = false;
+            *value = id;
+        }
+    }
+    catch (interruption&)
+    {
+    }
+    return ok;
+}
+
+std::vector<int>
+make_sequence(int n)
+{
+    std::vector<int> ids(n);
+    for (int i = 0; i != n; ++i)
+        ids[i] = i;
+    return ids;
+}
+
+// the number of nodes that a graph holds after an empty traversal
+std::size_t
+get_empty_graph_node_count()
+{
+    data_graph graph;
+    traverse_blocks(graph, {});
+    return graph.node_allocator.live_node_count;
+}
+
+} // namespace
+
+TEST_CASE(named_blocks, reordering_reuses_blocks)
+{
+    data_graph graph;
+    std::vector<int> ids = make_sequence(100);
+    CHECK(traverse_blocks(graph, ids, ids));
+
+    // removal at the head
+    ids.erase(ids.begin());
+    CHECK(traverse_blocks(graph, ids));
+    // insertion at the head
+    ids.insert(ids.begin(), 1000);
+    CHECK(traverse_blocks(graph, ids, {1000}));
+    // a swap
+    std::swap(ids[0], ids[1]);
+    CHECK(traverse_blocks(graph, ids));
+    // a block moving further than the lookahead covers
+    std::rotate(ids.begin(), ids.end() - 1, ids.end());
+    CHECK(traverse_blocks(graph, ids));
+    // a full shuffle
+    std::shuffle(ids.begin(), ids.end(), std::mt19937(1));
+    CHECK(traverse_blocks(graph, ids));
+
+    // Dropping everything releases all the blocks.
+    CHECK(traverse_blocks(graph, {}));
+    CHECK(
+        graph.node_allocator.live_node_count == get_empty_graph_node_count());
+}
+
+TEST_CASE(named_blocks, interrupted_reordered_traversal)
+{
+    data_graph graph;
+    std::vector<int> ids = make_sequence(20);
+    CHECK(traverse_blocks(graph, ids, ids));
+
+    // The first block requested is found by looking ahead, so the block
+    // before it is skipped, and then the traversal is interrupted.
+    std::vector<int> reordered = ids;
+    std::swap(reordered[0], reordered[1]);
+    CHECK(traverse_blocks(graph, reordered, {}, 1));
+
+    // All the blocks must have survived.
+    CHECK(traverse_blocks(graph, ids));
+    CHECK(traverse_blocks(graph, reordered));
+
+    // Do the same thing with a mix of edits near the head and interruptions
+    // at various points.
+    std::mt19937 rng(2);
+    for (int i = 0; i != 50; ++i)
+    {
+        std::vector<int> edited = ids;
+        edited.erase(edited.begin() + rng() % 4);
+        edited.insert(edited.begin() + rng() % 4, 100 + i);
+        std::swap(edited[rng() % 4], edited[rng() % 4]);
+        CHECK(traverse_blocks(graph, edited, {100 + i}, int(rng() % 6)));
+        // Everything that was there before the interrupted traversal must
+        // still be there.
+        CHECK(traverse_blocks(graph, ids));
+    }
+
+    CHECK(traverse_blocks(graph, {}));
+    CHECK(
+        graph.node_allocator.live_node_count == get_empty_graph_node_count());
+}
@@ -0,0 +1,128 @@
+#include "command_buffer.hpp"
+#include "headless_dom.hpp"
+#include "testing.hpp"
+
+using namespace dom;
+using namespace dom_tests;
+
+namespace {
+
+// This enables the node pool (with the given capacity) for the duration of a
+// test.
+struct scoped_node_pool
+{
+    scoped_node_pool(std::size_t capacity)
+    {
+        encode_configure_node_pool(get_command_buffer(), capacity);
+        flush_commands();
+        get_headless_document().reset_pool_stats();
+    }
+    ~scoped_node_pool()
+    {
+        encode_configure_node_pool(get_command_buffer(), 0);
+        flush_commands();
+        get_headless_document().reset_pool_stats();
+    }
+};
+
+// Create an element with the given tag inside :parent.
+int
+create_child(command_buffer& buffer, int parent, char const* tag)
+{
+    int id = allocate_node_id();
+    encode_create_element(buffer, id, intern_name(tag));
+    encode_insert_before(buffer, parent, id, 0);
+    return id;
+}
+
+} // namespace
+
+TEST_CASE(node_pool, released_elements_are_reused_clean)
+{
+    headless_document& document = get_headless_document();
+    command_buffer& buffer = get_command_buffer();
+    scoped_node_pool pool(4);
+
+    int parent = allocate_node_id();
+    encode_create_element(buffer, parent, intern_name("div"));
+
+    // Give an element all the kinds of state that it can have.
+    int used = create_child(buffer, parent, "input");
+    int child = create_child(buffer, used, "span");
+    encode_set_attribute(buffer, used, intern_name("placeholder"), "name");
+    encode_add_class(buffer, used, intern_name("invalid-input"));
+    encode_set_style(buffer, used, intern_name("color"), "red");
+    encode_set_string_property(buffer, used, intern_name("value"), "hello");
+    encode_set_boolean_property(buffer, used, intern_name("checked"), true);
+    flush_commands(buffer);
+    headless_node* node = document.get_node(used);
+    CHECK(node && !node->attributes.empty() && node->first_child);
+
+    // Removing it puts it in the pool.
+    encode_remove_child(buffer, used);
+    encode_remove_child(buffer, child);
+    flush_commands(buffer);
+    CHECK(document.pool_stats().size == 2);
+    CHECK(!document.get_node(used));
+
+    // Creating another one takes it back out, in a freshly created state.
+    int reused = create_child(buffer, parent, "input");
+    flush_commands(buffer);
+    headless_node* fresh = document.get_node(reused);
+    CHECK(fresh == node);
+    CHECK(document.pool_stats().hits == 1);
+    CHECK(document.pool_stats().size == 1);
+    if (fresh)
+    {
+        CHECK(fresh->id == reused);
+        CHECK(fresh->tag == "input");
+        CHECK(fresh->attributes.empty());
+        CHECK(fresh->style.empty());
+        CHECK(fresh->properties["value"].isUndefined());
+        CHECK(fresh->properties["checked"].isUndefined());
+        CHECK(!fresh->first_child);
+        CHECK(fresh->parent == document.get_node(parent));
+    }
+
+    // Other tags don't come from that pool.
+    auto misses = document.pool_stats().misses;
+    int other = create_child(buffer, parent, "button");
+    flush_commands(buffer);
+    CHECK(document.pool_stats().misses == misses + 1);
+    CHECK(document.pool_stats().size == 1);
+
+    queue_node_removal(buffer, reused, parent);
+    queue_node_removal(buffer, other, parent);
+    queue_node_removal(buffer, parent, 0);
+    flush_commands(buffer);
+}
+
+TEST_CASE(node_pool, pooling_is_limited)
+{
+    headless_document& document = get_headless_document();
+    command_buffer& buffer = get_command_buffer();
+    scoped_node_pool pool(2);
+
+    int parent = allocate_node_id();
+    encode_create_element(buffer, parent, intern_name("div"));
+    int ids[4];
+    for (int& id : ids)
+        id = create_child(buffer, parent, "li");
+    // Elements that delegate events are never pooled.
+    int delegating = create_child(buffer, parent, "li");
+    encode_delegate_events(buffer, delegating, intern_name("click"));
+    flush_commands(buffer);
+
+    encode_remove_child(buffer, delegating);
+    flush_commands(buffer);
+    CHECK(document.pool_stats().size == 0);
+
+    // Only as many as the capacity are kept.
+    for (int id : ids)
+        encode_remove_child(buffer, id);
+    flush_commands(buffer);
+    CHECK(document.pool_stats().size == 2);
+
+    encode_remove_child(buffer, parent);
+    flush_commands(buffer);
+}
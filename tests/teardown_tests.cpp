@@ -0,0 +1,225 @@
+#include "alia.hpp"
+
+#include "dom.hpp"
+#include "testing.hpp"
+
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+
+using namespace alia;
+using namespace dom;
+using namespace dom_tests;
+
+namespace {
+
+// Run :fn on a thread with a small (fixed) stack, so that anything that
+// recurses once per node overflows it, regardless of how the main thread's
+// stack is configured.
+template<class Fn>
+void
+run_with_small_stack(Fn fn)
+{
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, 256 * 1024);
+    pthread_t thread;
+    int result = pthread_create(
+        &thread,
+        &attributes,
+        [](void* arg) -> void* {
+            (*static_cast<Fn*>(arg))();
+            return nullptr;
+        },
+        &fn);
+    pthread_attr_destroy(&attributes);
+    CHECK(result == 0);
+    if (result == 0)
+        pthread_join(thread, nullptr);
+}
+
+bool show_list = false;
+std::vector<std::string> list_rows;
+
+void
+do_list_ui(dom::context ctx)
+{
+    ALIA_IF(show_list)
+    {
+        element(ctx, "ul").children([&](auto ctx) {
+            for_each(ctx, list_rows, [&](auto ctx, auto const& row) {
+                element(ctx, "li").text(row);
+            });
+        });
+    }
+    ALIA_END
+}
+
+std::vector<int> keyed_rows;
+
+void
+do_keyed_list_ui(dom::context ctx)
+{
+    element(ctx, "ul").keyed_children([&](auto ctx) {
+        naming_context nc(ctx);
+        for (int row : keyed_rows)
+        {
+            named_block nb(nc, make_id(row));
+            element(ctx, "li").children([&](auto ctx) {
+                element(ctx, "span").text(std::to_string(row));
+            });
+        }
+    });
+}
+
+std::size_t
+count_subtree(headless_node const& node)
+{
+    std::size_t count = 1;
+    for (headless_node const* child = node.first_child; child;
+         child = child->next_sibling)
+    {
+        count += count_subtree(*child);
+    }
+    return count;
+}
+
+} // namespace
+
+TEST_CASE(teardown, million_node_block)
+{
+    bool finished = false;
+    run_with_small_stack([&]() {
+        auto* graph = new data_graph;
+        {
+            data_traversal traversal;
+            scoped_data_traversal scoped(*graph, traversal);
+            for (int i = 0; i != 1000000; ++i)
+                get_data<int>(traversal) = i;
+        }
+        delete graph;
+        finished = true;
+    });
+    CHECK(finished);
+}
+
+TEST_CASE(teardown, long_named_block_list)
+{
+    bool finished = false;
+    run_with_small_stack([&]() {
+        auto* graph = new data_graph;
+        {
+            data_traversal traversal;
+            scoped_data_traversal scoped(*graph, traversal);
+            naming_context nc(traversal);
+            for (int i = 0; i != 100000; ++i)
+            {
+                named_block nb(nc, make_id(i));
+                get_data<int>(traversal) = i;
+            }
+        }
+        delete graph;
+        finished = true;
+    });
+    CHECK(finished);
+}
+
+TEST_CASE(teardown, subtree_removal)
+{
+    headless_document& document = get_headless_document();
+    command_buffer& buffer = get_command_buffer();
+    mount_placeholder(document, buffer, "teardown-root");
+
+    list_rows.clear();
+    for (int i = 0; i != 1000; ++i)
+        list_rows.push_back("row " + std::to_string(i));
+
+    dom::system dom_system;
+    alia::system alia_system;
+    show_list = false;
+    initialize(dom_system, alia_system, "teardown-root", do_list_ui);
+    flush_commands(buffer);
+    std::size_t baseline = document.node_count();
+
+    show_list = true;
+    refresh_system(alia_system);
+    flush_commands(buffer);
+    headless_node* root = document.get_node(dom_system.root_node.object.js_id);
+    CHECK(root && root->first_child);
+    if (!root || !root->first_child)
+        return;
+    headless_node& list = *root->first_child;
+    int list_id = list.id;
+    std::size_t subtree_size = count_subtree(list);
+    CHECK(subtree_size > 1000);
+    CHECK(document.node_count() == baseline + subtree_size);
+
+    {
+        scoped_command_recording recording;
+        show_list = false;
+        refresh_system(alia_system);
+        flush_commands(buffer);
+
+        auto const& recorder = recording.recorder;
+        CHECK(recorder.count("remove_child") == 1);
+        std::string removal = "remove_child " + std::to_string(list_id);
+        CHECK(!recorder.log.empty() && recorder.log.front() == removal);
+        CHECK(recorder.count("release_node") == int(subtree_size - 1));
+    }
+    CHECK(document.node_count() == baseline);
+    CHECK(!root->first_child);
+}
+
+TEST_CASE(teardown, keyed_row_removal)
+{
+    headless_document& document = get_headless_document();
+    command_buffer& buffer = get_command_buffer();
+    mount_placeholder(document, buffer, "keyed-teardown-root");
+
+    keyed_rows = {0, 1, 2};
+    dom::system dom_system;
+    alia::system alia_system;
+    initialize(
+        dom_system, alia_system, "keyed-teardown-root", do_keyed_list_ui);
+    flush_commands(buffer);
+    std::size_t node_count = document.node_count();
+
+    headless_node* root = document.get_node(dom_system.root_node.object.js_id);
+    CHECK(root && root->first_child && root->first_child->first_child);
+    if (!root || !root->first_child || !root->first_child->first_child)
+        return;
+    headless_node& row = *root->first_child->first_child->next_sibling;
+    int row_id = row.id;
+    std::size_t row_size = count_subtree(row);
+    CHECK(row_size == 3);
+
+    // The row's block (and with it, its descendants) is only destroyed after
+    // the traversal, but the descendants should still go along with the row.
+    {
+        scoped_command_recording recording;
+        keyed_rows = {0, 2};
+        refresh_system(alia_system);
+        flush_commands(buffer);
+
+        auto const& recorder = recording.recorder;
+        CHECK(recorder.count("remove_child") == 1);
+        std::string removal = "remove_child " + std::to_string(row_id);
+        CHECK(!recorder.log.empty() && recorder.log.front() == removal);
+        CHECK(recorder.count("release_node") == int(row_size - 1));
+    }
+    CHECK(document.node_count() == node_count - row_size);
+
+    // Removing the whole list still only removes its topmost node.
+    {
+        scoped_command_recording recording;
+        keyed_rows.clear();
+        refresh_system(alia_system);
+        flush_commands(buffer);
+
+        auto const& recorder = recording.recorder;
+        CHECK(recorder.count("remove_child") == 2);
+        CHECK(recorder.count("release_node") == 4);
+    }
+    CHECK(document.node_count() == node_count - 3 * row_size);
+}
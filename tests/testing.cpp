@@ -0,0 +1,232 @@
+#define ALIA_IMPLEMENTATION
+#include "alia.hpp"
+
+#include "testing.hpp"
+
+#include "dom.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace dom_tests {
+
+std::vector<test_case>&
+get_test_cases()
+{
+    static std::vector<test_case> cases;
+    return cases;
+}
+
+static int failure_count = 0;
+
+void
+report_failure(char const* file, int line, char const* condition)
+{
+    std::cout << file << ":" << line << ": CHECK(" << condition << ") failed"
+              << std::endl;
+    ++failure_count;
+}
+
+int
+command_recorder::count(std::string const& method) const
+{
+    int n = 0;
+    for (auto const& line : log)
+    {
+        if (line.compare(0, method.size(), method) == 0
+            && (line.size() == method.size() || line[method.size()] == ' '))
+        {
+            ++n;
+        }
+    }
+    return n;
+}
+
+void
+command_recorder::create_element(int id, char const* tag)
+{
+    log.push_back(
+        "create_element " + std::to_string(id) + " " + std::string(tag));
+}
+void
+command_recorder::create_text_node(int id, char const* text)
+{
+    log.push_back("create_text_node " + std::to_string(id) + " " + text);
+}
+void
+command_recorder::insert_before(int parent, int child, int before)
+{
+    log.push_back(
+        "insert_before " + std::to_string(parent) + " " + std::to_string(child)
+        + " " + std::to_string(before));
+}
+void
+command_recorder::remove_child(int id)
+{
+    log.push_back("remove_child " + std::to_string(id));
+}
+void
+command_recorder::detach_node(int id)
+{
+    log.push_back("detach_node " + std::to_string(id));
+}
+void
+command_recorder::release_node(int id)
+{
+    log.push_back("release_node " + std::to_string(id));
+}
+void
+command_recorder::set_attribute(int id, char const* name, char const* value)
+{
+    log.push_back(
+        "set_attribute " + std::to_string(id) + " " + name + " " + value);
+}
+void
+command_recorder::remove_attribute(int id, char const* name)
+{
+    log.push_back("remove_attribute " + std::to_string(id) + " " + name);
+}
+void
+command_recorder::set_node_value(int id, char const* text)
+{
+    log.push_back("set_node_value " + std::to_string(id) + " " + text);
+}
+void
+command_recorder::set_string_property(
+    int id, char const* name, char const* value)
+{
+    log.push_back(
+        "set_string_property " + std::to_string(id) + " " + name + " "
+        + value);
+}
+void
+command_recorder::set_number_property(int id, char const* name, double value)
+{
+    log.push_back(
+        "set_number_property " + std::to_string(id) + " " + name + " "
+        + std::to_string(value));
+}
+void
+command_recorder::set_boolean_property(int id, char const* name, bool value)
+{
+    log.push_back(
+        "set_boolean_property " + std::to_string(id) + " " + name + " "
+        + (value ? "true" : "false"));
+}
+void
+command_recorder::remove_property(int id, char const* name)
+{
+    log.push_back("remove_property " + std::to_string(id) + " " + name);
+}
+void
+command_recorder::delegate_events(int id, char const* event_type)
+{
+    log.push_back("delegate_events " + std::to_string(id) + " " + event_type);
+}
+void
+command_recorder::set_style(int id, char const* name, char const* value)
+{
+    log.push_back(
+        "set_style " + std::to_string(id) + " " + name + " " + value);
+}
+void
+command_recorder::remove_style(int id, char const* name)
+{
+    log.push_back("remove_style " + std::to_string(id) + " " + name);
+}
+void
+command_recorder::add_class(int id, char const* name)
+{
+    log.push_back("add_class " + std::to_string(id) + " " + name);
+}
+void
+command_recorder::remove_class(int id, char const* name)
+{
+    log.push_back("remove_class " + std::to_string(id) + " " + name);
+}
+void
+command_recorder::define_template(int template_id, char const* html)
+{
+    log.push_back(
+        "define_template " + std::to_string(template_id) + " " + html);
+}
+void
+command_recorder::clone_template(int id, int template_id)
+{
+    log.push_back(
+        "clone_template " + std::to_string(id) + " "
+        + std::to_string(template_id));
+}
+void
+command_recorder::begin_hydration(int id)
+{
+    log.push_back("begin_hydration " + std::to_string(id));
+}
+void
+command_recorder::end_hydration(int id)
+{
+    log.push_back("end_hydration " + std::to_string(id));
+}
+void
+command_recorder::configure_node_pool(std::size_t capacity)
+{
+    log.push_back("configure_node_pool " + std::to_string(capacity));
+}
+
+scoped_command_recording::scoped_command_recording()
+{
+    dom::command_buffer& buffer = dom::get_command_buffer();
+    dom::flush_commands(buffer);
+    old_executor_ = buffer.executor;
+    buffer.executor = [this](std::uint32_t const* words, std::size_t size) {
+        // The recorder needs to know about the names that were defined
+        // before it started.
+        dom::headless_document& document = dom::get_headless_document();
+        if (recorder.names.size() < document.names.size())
+            recorder.names = document.names;
+        dom::decode_commands(words, size, recorder);
+        old_executor_(words, size);
+    };
+}
+
+scoped_command_recording::~scoped_command_recording()
+{
+    dom::command_buffer& buffer = dom::get_command_buffer();
+    dom::flush_commands(buffer);
+    buffer.executor = old_executor_;
+}
+
+} // namespace dom_tests
+
+int
+main(int argc, char** argv)
+{
+    using namespace dom_tests;
+
+    dom::headless_document& document = dom::get_headless_document();
+    dom::get_command_buffer().executor
+        = [&](std::uint32_t const* words, std::size_t size) {
+              dom::decode_commands(words, size, document);
+          };
+
+    int run_count = 0;
+    for (test_case const& test : get_test_cases())
+    {
+        if (argc > 1 && std::strcmp(argv[1], test.group) != 0)
+            continue;
+        int failures_before = failure_count;
+        test.run();
+        dom::flush_commands();
+        std::cout << (failure_count == failures_before ? "passed: "
+                                                       : "FAILED: ")
+                  << test.group << "." << test.name << std::endl;
+        ++run_count;
+    }
+
+    if (run_count == 0)
+    {
+        std::cout << "no tests matched" << std::endl;
+        return 1;
+    }
+    return failure_count == 0 ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+#ifndef TESTING_HPP
+#define TESTING_HPP
+
+#include "command_buffer.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// This file provides a (very) small harness for the native tests.
+//
+// TEST_CASE(group, name) defines a test. The runner (testing.cpp) runs every
+// test in the group named on its command line (or every test, if there isn't
+// one). CHECK(condition) records a failure (and carries on with the test), and
+// the runner fails if any check failed.
+//
+// Before running the tests, the runner installs an executor for the global
+// command buffer that applies commands to the headless document, just as
+// main-headless does.
+
+namespace dom_tests {
+
+struct test_case
+{
+    char const* group;
+    char const* name;
+    void (*run)();
+};
+
+std::vector<test_case>&
+get_test_cases();
+
+struct test_registrar
+{
+    test_registrar(char const* group, char const* name, void (*run)())
+    {
+        get_test_cases().push_back(test_case{group, name, run});
+    }
+};
+
+void
+report_failure(char const* file, int line, char const* condition);
+
+#define TEST_CASE(group, name)                                                \
+    static void test_##group##_##name();                                      \
+    static ::dom_tests::test_registrar register_##group##_##name(             \
+        #group, #name, test_##group##_##name);                                \
+    static void test_##group##_##name()
+
+#define CHECK(condition)                                                      \
+    ((condition) ? void()                                                     \
+                 : ::dom_tests::report_failure(__FILE__, __LINE__, #condition))
+
+// command_recorder is a command_handler that just records the commands that it
+// receives, one line per command (e.g., "remove_child 12").
+struct command_recorder : dom::command_handler
+{
+    std::vector<std::string> log;
+
+    // the number of recorded commands that invoked the given method
+    int
+    count(std::string const& method) const;
+
+    void
+    create_element(int id, char const* tag);
+    void
+    create_text_node(int id, char const* text);
+    void
+    insert_before(int parent, int child, int before);
+    void
+    remove_child(int id);
+    void
+    detach_node(int id);
+    void
+    release_node(int id);
+    void
+    set_attribute(int id, char const* name, char const* value);
+    void
+    remove_attribute(int id, char const* name);
+    void
+    set_node_value(int id, char const* text);
+    void
+    set_string_property(int id, char const* name, char const* value);
+    void
+    set_number_property(int id, char const* name, double value);
+    void
+    set_boolean_property(int id, char const* name, bool value);
+    void
+    remove_property(int id, char const* name);
+    void
+    delegate_events(int id, char const* event_type);
+    void
+    set_style(int id, char const* name, char const* value);
+    void
+    remove_style(int id, char const* name);
+    void
+    add_class(int id, char const* name);
+    void
+    remove_class(int id, char const* name);
+    void
+    define_template(int template_id, char const* html);
+    void
+    clone_template(int id, int template_id);
+    void
+    begin_hydration(int id);
+    void
+    end_hydration(int id);
+    void
+    configure_node_pool(std::size_t capacity);
+};
+
+// While a scoped_command_recording exists, the commands that are executed from
+// the global command buffer are also recorded (in addition to being applied to
+// the headless document).
+struct scoped_command_recording
+{
+    scoped_command_recording();
+    ~scoped_command_recording();
+
+    command_recorder recorder;
+
+ private:
+    std::function<void(std::uint32_t const* words, std::size_t size)>
+        old_executor_;
+};
+
+} // namespace dom_tests
+
+#endif
@@ -0,0 +1,125 @@
+#include "alia.hpp"
+
+#include "dom.hpp"
+#include "testing.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace alia;
+using namespace dom;
+using namespace dom_tests;
+
+namespace {
+
+std::vector<int> list_items;
+
+void
+do_virtual_list_ui(dom::context ctx)
+{
+    virtual_list(
+        ctx, value(list_items), 20, [&](auto ctx, std::size_t, int item) {
+            element(ctx, "span").text(std::to_string(item));
+        });
+}
+
+std::string
+get_style(headless_node const& node, std::string const& name)
+{
+    for (auto const& property : node.style)
+    {
+        if (property.first == name)
+            return property.second;
+    }
+    return "";
+}
+
+// Get the item shown in a row of the list.
+int
+get_row_item(headless_node const& row)
+{
+    headless_node const* span = row.first_child;
+    return span && span->first_child ? std::stoi(span->first_child->text)
+                                     : -1;
+}
+
+std::size_t
+count_children(headless_node const& node)
+{
+    std::size_t count = 0;
+    for (headless_node const* child = node.first_child; child;
+         child = child->next_sibling)
+    {
+        ++count;
+    }
+    return count;
+}
+
+} // namespace
+
+TEST_CASE(virtual_list, scrolling_moves_the_window)
+{
+    headless_document& document = get_headless_document();
+    command_buffer& buffer = get_command_buffer();
+    mount_placeholder(document, buffer, "virtual-list-root");
+
+    list_items.resize(10000);
+    for (int i = 0; i != 10000; ++i)
+        list_items[i] = i;
+
+    dom::system dom_system;
+    alia::system alia_system;
+    initialize(
+        dom_system, alia_system, "virtual-list-root", do_virtual_list_ui);
+    headless_node* root = document.get_node(dom_system.root_node.object.js_id);
+    CHECK(root && root->first_child);
+    if (!root || !root->first_child)
+        return;
+    headless_node& list = *root->first_child;
+
+    // The list measures its viewport on the refresh after it's inserted.
+    list.properties.set("clientHeight", 400);
+    refresh_system(alia_system);
+    flush_commands(buffer);
+
+    // At the top, there are 400 / 20 + 1 visible rows, plus the overscan
+    // below them, and the spacers.
+    std::size_t row_count = 400 / 20 + 1 + virtual_list_overscan;
+    CHECK(count_children(list) == row_count + 2);
+    CHECK(get_style(*list.first_child, "height") == "0px");
+    CHECK(get_row_item(*list.first_child->next_sibling) == 0);
+    CHECK(
+        get_style(*list.last_child, "height")
+        == std::to_string((10000 - row_count) * 20) + "px");
+
+    // Scrolling to 5000px puts row 250 at the top of the viewport, so with
+    // the overscan, the window starts at row 242.
+    list.properties.set("scrollTop", 5000);
+    document.dispatch_event(list, "scroll", headless_value::object(), false);
+    flush_commands(buffer);
+    std::size_t end = (5000 + 400) / 20 + 1 + virtual_list_overscan;
+    CHECK(count_children(list) == end - 242 + 2);
+    CHECK(get_style(*list.first_child, "height") == "4840px");
+    headless_node* first_row = list.first_child->next_sibling;
+    CHECK(first_row && get_row_item(*first_row) == 242);
+    CHECK(get_row_item(*list.last_child->previous_sibling) == int(end - 1));
+    CHECK(
+        get_style(*list.last_child, "height")
+        == std::to_string((10000 - end) * 20) + "px");
+
+    // Scrolling five rows further leaves the rows that are still visible
+    // alone, and only the five new ones (each a div, a span and a text node)
+    // are created and inserted.
+    headless_node* row_247 = first_row;
+    for (int i = 0; i != 5 && row_247; ++i)
+        row_247 = row_247->next_sibling;
+    CHECK(row_247 && get_row_item(*row_247) == 247);
+    list.properties.set("scrollTop", 5100);
+    document.dispatch_event(list, "scroll", headless_value::object(), false);
+    flush_commands(buffer);
+    CHECK(get_style(*list.first_child, "height") == "4940px");
+    CHECK(list.first_child->next_sibling == row_247);
+    CHECK(dom_system.last_refresh_mutations.created_elements == 5 * 2);
+    CHECK(dom_system.last_refresh_mutations.created_text_nodes == 5);
+    CHECK(dom_system.last_refresh_mutations.insertions == 5 * 3);
+}